@@ -0,0 +1,103 @@
+#include "desktopcapture.h"
+
+#include <QGuiApplication>
+#include <QScreen>
+#include <QPainter>
+#include <QtConcurrent>
+#include <QtMath>
+
+DesktopCapture DesktopCapture::grab(const QColor &mask)
+{
+    DesktopCapture capture;
+    QList<QImage> images;
+
+    // QScreen::grabWindow 只能在 GUI 线程中调用，逐个屏幕抓取
+    const QList<QScreen*> screens = QGuiApplication::screens();
+    for (QScreen *screen : screens) {
+        const QPixmap pixmap = screen->grabWindow(0);
+        if (pixmap.isNull()) {
+            qWarning("抓取屏幕 %s 失败", qPrintable(screen->name()));
+            continue;
+        }
+        ScreenGrab entry;
+        entry.rect = screen->geometry();
+        entry.pixmap = pixmap;
+        capture.m_screens.append(entry);
+        capture.m_geometry |= entry.rect;
+        images.append(pixmap.toImage());
+    }
+    if (capture.m_screens.isEmpty())
+        return capture;
+
+    // 遮罩在线程池中按屏幕并行叠加，之后的重绘只需要复制
+    const QList<QImage> darkened = QtConcurrent::blockingMapped<QList<QImage>>(images, [mask](const QImage &image) {
+        QImage result = image.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+        QPainter painter(&result);
+        painter.setCompositionMode(QPainter::CompositionMode_SourceOver);
+        painter.fillRect(QRect(QPoint(0, 0), result.size() / result.devicePixelRatio()), mask);
+        return result;
+    });
+
+    for (int i = 0; i < capture.m_screens.size(); ++i) {
+        ScreenGrab &entry = capture.m_screens[i];
+        entry.rect.translate(-capture.m_geometry.topLeft());
+        entry.darkened = darkened.at(i);
+    }
+    return capture;
+}
+
+QRectF DesktopCapture::sourceRect(const ScreenGrab &screen, const QRect &rect)
+{
+    // 按截图与屏幕的实际尺寸之比换算，不依赖各平台对设备像素比的取整
+    const qreal scaleX = screen.pixmap.width() / qreal(screen.rect.width());
+    const qreal scaleY = screen.pixmap.height() / qreal(screen.rect.height());
+    return QRectF(rect.x() * scaleX, rect.y() * scaleY, rect.width() * scaleX, rect.height() * scaleY);
+}
+
+void DesktopCapture::paint(QPainter *painter, const QRect &dirty, const QRect &selection) const
+{
+    for (const ScreenGrab &screen : m_screens) {
+        const QRect area = dirty & screen.rect;
+        if (area.isEmpty())
+            continue;
+        painter->drawImage(QRectF(area), screen.darkened, sourceRect(screen, area.translated(-screen.rect.topLeft())));
+        const QRect bright = area & selection;
+        if (!bright.isEmpty())
+            painter->drawPixmap(QRectF(bright), screen.pixmap, sourceRect(screen, bright.translated(-screen.rect.topLeft())));
+    }
+}
+
+QPixmap DesktopCapture::crop(const QRect &rect) const
+{
+    QVector<const ScreenGrab*> hits;
+    qreal ratio = 0;
+    for (const ScreenGrab &screen : m_screens) {
+        if (screen.rect.intersects(rect)) {
+            hits.append(&screen);
+            ratio = qMax(ratio, screen.pixmap.width() / qreal(screen.rect.width()));
+        }
+    }
+    if (hits.isEmpty())
+        return QPixmap();
+
+    // 选区在一个屏幕之内时直接复制该屏幕的像素
+    if (hits.size() == 1) {
+        const ScreenGrab &screen = *hits.first();
+        const QRect part = (rect & screen.rect).translated(-screen.rect.topLeft());
+        return screen.pixmap.copy(sourceRect(screen, part).toAlignedRect());
+    }
+
+    // 跨屏幕时只合成经过的屏幕，低分辨率屏幕的部分放大到最高的设备像素比
+    QPixmap result(qCeil(rect.width() * ratio), qCeil(rect.height() * ratio));
+    result.fill(Qt::black);
+    QPainter painter(&result);
+    painter.setRenderHint(QPainter::SmoothPixmapTransform);
+    for (const ScreenGrab *screen : hits) {
+        const QRect part = rect & screen->rect;
+        const QRectF target(QPointF(part.topLeft() - rect.topLeft()) * ratio, QSizeF(part.size()) * ratio);
+        painter.drawPixmap(target, screen->pixmap, sourceRect(*screen, part.translated(-screen->rect.topLeft())));
+    }
+    painter.end();
+    result.setDevicePixelRatio(ratio);
+    return result;
+}
@@ -0,0 +1,46 @@
+#ifndef DESKTOPCAPTURE_H
+#define DESKTOPCAPTURE_H
+
+#include <QColor>
+#include <QImage>
+#include <QPixmap>
+#include <QRect>
+#include <QVector>
+
+class QPainter;
+
+// 整个虚拟桌面的截图。每个屏幕按自身的设备像素比单独保存，不预先拼接成一张大图；
+// 选区窗口按屏幕分别绘制，裁剪时只合成选区经过的屏幕。
+// 以下矩形都是相对虚拟桌面左上角的逻辑坐标（即覆盖整个桌面的选区窗口的坐标）
+class DesktopCapture
+{
+public:
+    DesktopCapture() = default;
+
+    // 抓取所有屏幕，并在线程池中按屏幕并行生成叠加了 mask 的变暗副本
+    static DesktopCapture grab(const QColor &mask);
+
+    bool isNull() const { return m_screens.isEmpty(); }
+    // 虚拟桌面的全局逻辑坐标
+    QRect geometry() const { return m_geometry; }
+
+    // 绘制 dirty 区域：selection 以外为变暗的背景，selection 内为原图
+    void paint(QPainter *painter, const QRect &dirty, const QRect &selection) const;
+    // 裁剪 rect 范围的原图，分辨率取所经过屏幕中最高的设备像素比
+    QPixmap crop(const QRect &rect) const;
+
+private:
+    struct ScreenGrab {
+        QRect rect;         // 相对虚拟桌面左上角的逻辑坐标
+        QPixmap pixmap;     // 原生分辨率
+        QImage darkened;
+    };
+
+    // 屏幕内逻辑坐标 rect 对应的截图像素区域
+    static QRectF sourceRect(const ScreenGrab &screen, const QRect &rect);
+
+    QVector<ScreenGrab> m_screens;
+    QRect m_geometry;
+};
+
+#endif // DESKTOPCAPTURE_H
@@ -0,0 +1,308 @@
+#include "draftcommands.h"
+#include "draftwidget.h"
+#include "pixmapstore.h"
+#include "resizablepixmapitem.h"
+
+#include <QCoreApplication>
+#include <QGraphicsScene>
+#include <QHash>
+
+// 同一组项的两次操作间隔不超过该时间时合并为一条命令
+const int MERGE_WINDOW_MS = 500;
+
+static QString translate(const char *text)
+{
+    return QCoreApplication::translate("DraftCommands", text);
+}
+
+// 从项列表和对应的新旧值中去掉 item，返回列表是否因此变空
+template <typename T>
+static bool forgetRecord(QList<QGraphicsItem*> &items, QVector<T> &oldValues, QVector<T> &newValues,
+                         QGraphicsItem *item)
+{
+    const int index = items.indexOf(item);
+    if (index < 0)
+        return false;
+    items.removeAt(index);
+    oldValues.removeAt(index);
+    newValues.removeAt(index);
+    return items.isEmpty();
+}
+
+// 一组不在场景中的项持有的内存。PixmapStore 中共享的像素只计一次；
+// 仓库中还有其他引用时，丢弃这些项并不会释放共享的像素，不计入
+template <typename Item>
+static qint64 detachedBytes(const QList<Item*> &items)
+{
+    struct Shared {
+        int count = 0;
+        qint64 bytes = 0;
+    };
+
+    qint64 bytes = 0;
+    QHash<qint64, Shared> shared;
+    for (Item *item : items) {
+        const ResizablePixmapItem *pixmapItem = dynamic_cast<const ResizablePixmapItem*>(item);
+        if (!pixmapItem)
+            continue;
+        bytes += pixmapItem->memoryBytes();
+        if (const qint64 key = pixmapItem->storeKey()) {
+            const qint64 pixelBytes = ResizablePixmapItem::pixmapBytes(pixmapItem->pixmap());
+            bytes -= pixelBytes;
+            Shared &entry = shared[key];
+            ++entry.count;
+            entry.bytes = pixelBytes;
+        }
+    }
+    for (auto it = shared.cbegin(); it != shared.cend(); ++it) {
+        if (PixmapStore::instance().refCount(it.key()) <= it.value().count)
+            bytes += it.value().bytes;
+    }
+    return bytes;
+}
+
+ItemsCommand::ItemsCommand(DraftWidget *draft, const QList<QGraphicsItem*> &items, const QString &text)
+    : UndoCommand(text),
+      m_draft(draft),
+      m_items(items),
+      m_attached(!items.isEmpty() && items.first()->scene() == draft->scene())
+{
+}
+
+ItemsCommand::~ItemsCommand()
+{
+    // 不在场景中的项只被本命令引用
+    if (!m_attached) {
+        for (QGraphicsItem *item : m_items) {
+            m_draft->discardItem(item);
+        }
+    }
+}
+
+void ItemsCommand::attach()
+{
+    if (m_attached)
+        return;
+    // 单项的撤销/重做直接增删，不值得让整棵 BSP 树重建
+    const bool batch = m_draft->shouldBatch(m_items.size());
+    if (batch)
+        m_draft->beginBatch();
+    m_draft->scene()->clearSelection();
+    for (QGraphicsItem *item : m_items) {
+        m_draft->scene()->addItem(item);
+        item->setSelected(true);
+    }
+    if (batch)
+        m_draft->endBatch();
+    m_attached = true;
+}
+
+void ItemsCommand::detach()
+{
+    if (!m_attached)
+        return;
+    const bool batch = m_draft->shouldBatch(m_items.size());
+    if (batch)
+        m_draft->beginBatch();
+    // 先一次性清空选择，逐个移除时就不会每项都发出 selectionChanged
+    m_draft->scene()->clearSelection();
+    for (QGraphicsItem *item : m_items) {
+        m_draft->detachItem(item);
+    }
+    if (batch)
+        m_draft->endBatch();
+    m_attached = false;
+}
+
+qint64 ItemsCommand::memoryBytes() const
+{
+    if (m_attached)
+        return 0;
+
+    return detachedBytes(m_items);
+}
+
+bool ItemsCommand::forgetItem(QGraphicsItem *item)
+{
+    // 只会对场景中的项调用，此时命令并不持有它，直接去掉引用即可
+    return m_items.removeOne(item) && m_items.isEmpty();
+}
+
+AddItemsCommand::AddItemsCommand(DraftWidget *draft, const QList<QGraphicsItem*> &items)
+    : ItemsCommand(draft, items, translate("添加图片"))
+{
+}
+
+RemoveItemsCommand::RemoveItemsCommand(DraftWidget *draft, const QList<QGraphicsItem*> &items)
+    : ItemsCommand(draft, items, translate("删除"))
+{
+}
+
+MoveItemsCommand::MoveItemsCommand(const QList<QGraphicsItem*> &items, const QVector<QPointF> &oldPositions,
+                                   const QVector<QPointF> &newPositions)
+    : UndoCommand(translate("移动")),
+      m_items(items),
+      m_oldPositions(oldPositions),
+      m_newPositions(newPositions)
+{
+    m_lastChange.start();
+}
+
+void MoveItemsCommand::undo()
+{
+    for (int i = 0; i < m_items.size(); ++i) {
+        m_items.at(i)->setPos(m_oldPositions.at(i));
+    }
+}
+
+void MoveItemsCommand::redo()
+{
+    for (int i = 0; i < m_items.size(); ++i) {
+        m_items.at(i)->setPos(m_newPositions.at(i));
+    }
+}
+
+bool MoveItemsCommand::mergeWith(const UndoCommand *other)
+{
+    const MoveItemsCommand *move = static_cast<const MoveItemsCommand*>(other);
+    if (move->m_items != m_items || m_lastChange.elapsed() > MERGE_WINDOW_MS)
+        return false;
+    m_newPositions = move->m_newPositions;
+    m_lastChange.start();
+    return true;
+}
+
+bool MoveItemsCommand::forgetItem(QGraphicsItem *item)
+{
+    return forgetRecord(m_items, m_oldPositions, m_newPositions, item);
+}
+
+TransformItemsCommand::TransformItemsCommand(const QList<QGraphicsItem*> &items,
+                                             const QVector<QTransform> &oldTransforms,
+                                             const QVector<QTransform> &newTransforms)
+    : UndoCommand(translate("缩放")),
+      m_items(items),
+      m_oldTransforms(oldTransforms),
+      m_newTransforms(newTransforms)
+{
+    m_lastChange.start();
+}
+
+void TransformItemsCommand::undo()
+{
+    for (int i = 0; i < m_items.size(); ++i) {
+        m_items.at(i)->setTransform(m_oldTransforms.at(i));
+    }
+}
+
+void TransformItemsCommand::redo()
+{
+    for (int i = 0; i < m_items.size(); ++i) {
+        m_items.at(i)->setTransform(m_newTransforms.at(i));
+    }
+}
+
+bool TransformItemsCommand::mergeWith(const UndoCommand *other)
+{
+    const TransformItemsCommand *transform = static_cast<const TransformItemsCommand*>(other);
+    if (transform->m_items != m_items || m_lastChange.elapsed() > MERGE_WINDOW_MS)
+        return false;
+    m_newTransforms = transform->m_newTransforms;
+    m_lastChange.start();
+    return true;
+}
+
+bool TransformItemsCommand::forgetItem(QGraphicsItem *item)
+{
+    return forgetRecord(m_items, m_oldTransforms, m_newTransforms, item);
+}
+
+ZOrderCommand::ZOrderCommand(const QList<QGraphicsItem*> &items, const QVector<qreal> &oldValues,
+                             const QVector<qreal> &newValues, const QString &text)
+    : UndoCommand(text),
+      m_items(items),
+      m_oldValues(oldValues),
+      m_newValues(newValues)
+{
+}
+
+void ZOrderCommand::undo()
+{
+    for (int i = 0; i < m_items.size(); ++i) {
+        m_items.at(i)->setZValue(m_oldValues.at(i));
+    }
+}
+
+void ZOrderCommand::redo()
+{
+    for (int i = 0; i < m_items.size(); ++i) {
+        m_items.at(i)->setZValue(m_newValues.at(i));
+    }
+}
+
+bool ZOrderCommand::forgetItem(QGraphicsItem *item)
+{
+    return forgetRecord(m_items, m_oldValues, m_newValues, item);
+}
+
+FlattenCommand::FlattenCommand(DraftWidget *draft, const QList<ResizablePixmapItem*> &items,
+                               ResizablePixmapItem *flattened)
+    : UndoCommand(translate("合并选中项")),
+      m_draft(draft),
+      m_items(items),
+      m_flattened(flattened),
+      m_done(false)
+{
+}
+
+FlattenCommand::~FlattenCommand()
+{
+    if (m_done) {
+        for (ResizablePixmapItem *item : m_items) {
+            m_draft->discardItem(item);
+        }
+    } else {
+        m_draft->discardItem(m_flattened);
+    }
+}
+
+void FlattenCommand::redo()
+{
+    m_draft->beginBatch();
+    m_draft->scene()->clearSelection();
+    for (ResizablePixmapItem *item : m_items) {
+        m_draft->detachItem(item);
+    }
+    m_draft->scene()->addItem(m_flattened);
+    m_flattened->setSelected(true);
+    m_draft->endBatch();
+    m_done = true;
+}
+
+void FlattenCommand::undo()
+{
+    m_draft->beginBatch();
+    m_draft->scene()->clearSelection();
+    m_draft->detachItem(m_flattened);
+    for (ResizablePixmapItem *item : m_items) {
+        m_draft->scene()->addItem(item);
+        item->setSelected(true);
+    }
+    m_draft->endBatch();
+    m_done = false;
+}
+
+qint64 FlattenCommand::memoryBytes() const
+{
+    if (!m_done)
+        return m_flattened->memoryBytes();
+
+    return detachedBytes(m_items);
+}
+
+bool FlattenCommand::forgetItem(QGraphicsItem *item)
+{
+    // 只会对场景中的项调用，即合并已被撤销、原来的项都在场景中的时候
+    ResizablePixmapItem *pixmapItem = dynamic_cast<ResizablePixmapItem*>(item);
+    return pixmapItem && m_items.removeOne(pixmapItem) && m_items.isEmpty();
+}
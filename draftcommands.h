@@ -0,0 +1,137 @@
+#ifndef DRAFTCOMMANDS_H
+#define DRAFTCOMMANDS_H
+
+#include <QList>
+#include <QVector>
+#include <QPointF>
+#include <QTransform>
+#include <QElapsedTimer>
+
+#include "undostack.h"
+
+class DraftWidget;
+class ResizablePixmapItem;
+class QGraphicsItem;
+
+// 草稿上的可撤销操作。命令只保存位置、变换和层次等几何数据，像素留在项中；
+// 移出场景的项由命令持有，命令被丢弃时才真正删除
+
+// 可以合并的命令的 id
+enum DraftCommandId {
+    MoveCommandId = 1,
+    TransformCommandId
+};
+
+// 加入或移除一组项的公共部分
+class ItemsCommand : public UndoCommand
+{
+public:
+    ~ItemsCommand() override;
+    qint64 memoryBytes() const override;
+    bool forgetItem(QGraphicsItem *item) override;
+
+protected:
+    ItemsCommand(DraftWidget *draft, const QList<QGraphicsItem*> &items, const QString &text);
+    void attach();
+    void detach();
+
+    DraftWidget *m_draft;
+    QList<QGraphicsItem*> m_items;
+    bool m_attached; // 项当前是否在场景中，不在时由命令持有
+};
+
+// 加入项。项可以在压栈前已经加入场景（粘贴、拖放），第一次 redo 时不会重复加入
+class AddItemsCommand : public ItemsCommand
+{
+public:
+    AddItemsCommand(DraftWidget *draft, const QList<QGraphicsItem*> &items);
+    void undo() override { detach(); }
+    void redo() override { attach(); }
+};
+
+// 删除项：项移出场景后由命令持有，撤销时原样放回
+class RemoveItemsCommand : public ItemsCommand
+{
+public:
+    RemoveItemsCommand(DraftWidget *draft, const QList<QGraphicsItem*> &items);
+    void undo() override { attach(); }
+    void redo() override { detach(); }
+};
+
+// 移动项。同一组项在短时间内的连续拖动合并为一条命令
+class MoveItemsCommand : public UndoCommand
+{
+public:
+    MoveItemsCommand(const QList<QGraphicsItem*> &items, const QVector<QPointF> &oldPositions,
+                     const QVector<QPointF> &newPositions);
+
+    void undo() override;
+    void redo() override;
+    int id() const override { return MoveCommandId; }
+    bool mergeWith(const UndoCommand *other) override;
+    bool forgetItem(QGraphicsItem *item) override;
+
+private:
+    QList<QGraphicsItem*> m_items;
+    QVector<QPointF> m_oldPositions;
+    QVector<QPointF> m_newPositions;
+    QElapsedTimer m_lastChange;
+};
+
+// 改变项的变换（控制点缩放）。同一组项在短时间内的连续缩放合并为一条命令
+class TransformItemsCommand : public UndoCommand
+{
+public:
+    TransformItemsCommand(const QList<QGraphicsItem*> &items, const QVector<QTransform> &oldTransforms,
+                          const QVector<QTransform> &newTransforms);
+
+    void undo() override;
+    void redo() override;
+    int id() const override { return TransformCommandId; }
+    bool mergeWith(const UndoCommand *other) override;
+    bool forgetItem(QGraphicsItem *item) override;
+
+private:
+    QList<QGraphicsItem*> m_items;
+    QVector<QTransform> m_oldTransforms;
+    QVector<QTransform> m_newTransforms;
+    QElapsedTimer m_lastChange;
+};
+
+// 改变项的层次
+class ZOrderCommand : public UndoCommand
+{
+public:
+    ZOrderCommand(const QList<QGraphicsItem*> &items, const QVector<qreal> &oldValues,
+                  const QVector<qreal> &newValues, const QString &text);
+
+    void undo() override;
+    void redo() override;
+    bool forgetItem(QGraphicsItem *item) override;
+
+private:
+    QList<QGraphicsItem*> m_items;
+    QVector<qreal> m_oldValues;
+    QVector<qreal> m_newValues;
+};
+
+// 把多个项合并为一个预先栅格化的项
+class FlattenCommand : public UndoCommand
+{
+public:
+    FlattenCommand(DraftWidget *draft, const QList<ResizablePixmapItem*> &items, ResizablePixmapItem *flattened);
+    ~FlattenCommand() override;
+
+    void undo() override;
+    void redo() override;
+    qint64 memoryBytes() const override;
+    bool forgetItem(QGraphicsItem *item) override;
+
+private:
+    DraftWidget *m_draft;
+    QList<ResizablePixmapItem*> m_items;
+    ResizablePixmapItem *m_flattened;
+    bool m_done; // 已合并：原来的项在命令中，合并后的项在场景中
+};
+
+#endif // DRAFTCOMMANDS_H
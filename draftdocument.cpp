@@ -0,0 +1,132 @@
+#include "draftdocument.h"
+#include "resizablepixmapitem.h"
+#include "tiledpixmapitem.h"
+#include "imagesource.h"
+#include "sceneindex.h"
+
+#include <QCoreApplication>
+#include <QGraphicsScene>
+#include <QDataStream>
+#include <QSaveFile>
+#include <QFile>
+#include <QImage>
+#include <QPixmap>
+
+static const quint32 kDraftMagic = 0x455A4450; // "EZDP"
+static const quint32 kDraftVersion = 1;
+
+static QString translate(const char *text)
+{
+    return QCoreApplication::translate("DraftDocument", text);
+}
+
+static void setError(QString *errorString, const QString &message)
+{
+    if (errorString)
+        *errorString = message;
+}
+
+bool DraftDocument::save(QGraphicsScene *scene, const QString &fileName, QString *errorString)
+{
+    // 先收集要保存的项，以便写入准确的数量
+    QList<ResizablePixmapItem*> items;
+    const QList<QGraphicsItem*> sceneItems = scene->items(Qt::AscendingOrder);
+    for (QGraphicsItem *item : sceneItems) {
+        ResizablePixmapItem *pixmapItem = dynamic_cast<ResizablePixmapItem*>(item);
+        if (!pixmapItem || pixmapItem->parentItem())
+            continue;
+        // 仍在加载的占位项没有可写入的像素，与其写出空图不如拒绝保存
+        const QSharedPointer<ImageSource> source = pixmapItem->fullResolutionSource();
+        if (pixmapItem->isPlaceholder() && (!source || !source->isAvailable())) {
+            setError(errorString, translate("还有图片正在加载，请等待加载完成后再保存。"));
+            return false;
+        }
+        items.append(pixmapItem);
+    }
+
+    // QSaveFile 保证写入失败时不会破坏原有文件
+    QSaveFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly)) {
+        setError(errorString, file.errorString());
+        return false;
+    }
+
+    QDataStream out(&file);
+    out.setVersion(QDataStream::Qt_5_15);
+    out << kDraftMagic << kDraftVersion << quint32(items.size());
+    for (const ResizablePixmapItem *item : items) {
+        const QImage image = item->toImage();
+        if (image.isNull()) {
+            file.cancelWriting();
+            setError(errorString, translate("无法读取图片的像素数据，草稿未保存。"));
+            return false;
+        }
+        out << item->pos() << item->transform() << item->zValue() << image;
+    }
+
+    if (out.status() != QDataStream::Ok || !file.commit()) {
+        setError(errorString, translate("写入草稿文件失败：%1").arg(file.errorString()));
+        return false;
+    }
+    return true;
+}
+
+bool DraftDocument::load(QGraphicsScene *scene, const QString &fileName, QString *errorString,
+                         int *itemCount)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        setError(errorString, file.errorString());
+        return false;
+    }
+
+    QDataStream in(&file);
+    in.setVersion(QDataStream::Qt_5_15);
+
+    quint32 magic = 0;
+    quint32 version = 0;
+    quint32 count = 0;
+    in >> magic >> version >> count;
+    if (magic != kDraftMagic) {
+        setError(errorString, translate("不是有效的草稿文件。"));
+        return false;
+    }
+    if (version > kDraftVersion) {
+        setError(errorString, translate("草稿文件版本 %1 过新，无法打开。").arg(version));
+        return false;
+    }
+
+    QList<ResizablePixmapItem*> items;
+    for (quint32 i = 0; i < count; ++i) {
+        QPointF pos;
+        QTransform transform;
+        qreal zValue = 0;
+        QImage image;
+        in >> pos >> transform >> zValue >> image;
+        if (in.status() != QDataStream::Ok) {
+            qDeleteAll(items);
+            setError(errorString, translate("草稿文件已损坏。"));
+            return false;
+        }
+
+        ResizablePixmapItem *item;
+        if (TiledPixmapItem::shouldTile(image.size())) {
+            item = new TiledPixmapItem(ImageSource::fromImage(image));
+        } else {
+            item = new ResizablePixmapItem(image);
+        }
+        item->setPos(pos);
+        item->setTransform(transform);
+        item->setZValue(zValue);
+        items.append(item);
+    }
+
+    // 全部读取成功后再加入场景，避免出现只加载了一半的草稿；加入期间暂停索引
+    SceneBulkLoadGuard bulkLoad(scene);
+    for (ResizablePixmapItem *item : items) {
+        scene->addItem(item);
+    }
+    if (itemCount)
+        *itemCount = items.size();
+    return true;
+}
@@ -0,0 +1,19 @@
+#ifndef DRAFTDOCUMENT_H
+#define DRAFTDOCUMENT_H
+
+#include <QString>
+
+class QGraphicsScene;
+
+// 草稿文件（.ezd）读写：用 QDataStream 保存每个图片项的像素、位置、变换和层级。
+// 只依赖 QGraphicsScene，因此既可用于 DraftWidget，也可用于无界面的批量导出。
+class DraftDocument
+{
+public:
+    static bool save(QGraphicsScene *scene, const QString &fileName, QString *errorString = nullptr);
+    // 把文件中的项追加到 scene，返回是否成功；itemCount 返回加载的项数
+    static bool load(QGraphicsScene *scene, const QString &fileName, QString *errorString = nullptr,
+                     int *itemCount = nullptr);
+};
+
+#endif // DRAFTDOCUMENT_H
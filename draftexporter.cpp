@@ -0,0 +1,219 @@
+#include "draftexporter.h"
+#include "streamingimagewriter.h"
+
+#include <QCoreApplication>
+#include <QFileInfo>
+#include <QGraphicsScene>
+#include <QImage>
+#include <QImageWriter>
+#include <QPainter>
+
+#include <cstring>
+
+static QString translate(const char *text)
+{
+    return QCoreApplication::translate("DraftExporter", text);
+}
+
+DraftExporter::DraftExporter(QGraphicsScene *scene)
+    : m_scene(scene),
+      m_cancelled(false)
+{
+}
+
+DraftExporter::DraftExporter(const SceneSnapshot &snapshot)
+    : m_scene(nullptr),
+      m_snapshot(snapshot),
+      m_cancelled(false)
+{
+}
+
+QRectF DraftExporter::contentRect(QGraphicsScene *scene, bool selectedOnly, qreal padding)
+{
+    // 只统计顶层项，控制点等子项不计入
+    QRectF rect;
+    const QList<QGraphicsItem*> items = selectedOnly ? scene->selectedItems() : scene->items();
+    for (const QGraphicsItem *item : items) {
+        if (item->parentItem() || !item->isVisible())
+            continue;
+        rect |= item->sceneBoundingRect();
+    }
+    if (rect.isEmpty())
+        return QRectF();
+
+    rect.adjust(-padding, -padding, padding, padding);
+    return QRectF(rect.toAlignedRect());
+}
+
+void DraftExporter::renderStrip(QPainter *painter, const QRectF &target, const QRectF &source)
+{
+    if (m_scene) {
+        m_scene->render(painter, target, source, Qt::IgnoreAspectRatio);
+        return;
+    }
+
+    // 快照路径：把 source 映射到 target 后直接绘制各项的图像
+    painter->translate(target.topLeft());
+    painter->scale(target.width() / source.width(), target.height() / source.height());
+    painter->translate(-source.topLeft());
+    painter->setClipRect(source);
+    m_snapshot.paint(painter, source);
+}
+
+QByteArray DraftExporter::resolveFormat(const QString &fileName, const Options &options)
+{
+    // 与 QImageWriter 相同：未指定格式时按文件后缀推断
+    if (!options.format.isEmpty())
+        return options.format.toLower();
+    return QFileInfo(fileName).suffix().toLower().toLatin1();
+}
+
+bool DraftExporter::canStream(const QString &fileName, const Options &options)
+{
+    return StreamingImageWriter::supportsFormat(resolveFormat(fileName, options));
+}
+
+qint64 DraftExporter::renderBufferBytes(const QSize &outputSize, const Options &options, bool streaming)
+{
+    if (outputSize.isEmpty())
+        return 0;
+    const bool opaque = options.background.alpha() == 255;
+    const qint64 width = outputSize.width();
+    const qint64 stripRows = qMax(1, qMin(options.stripHeight, outputSize.height()));
+    const qint64 stripBytes = width * stripRows * (4 + (opaque ? 3 : 4));
+    if (streaming)
+        return stripBytes;
+    return width * outputSize.height() * (opaque ? 3 : 4) + stripBytes;
+}
+
+QSize DraftExporter::outputSizeFor(const Options &options, QRectF *source)
+{
+    const QRectF sceneRect = m_scene ? m_scene->sceneRect() : m_snapshot.sceneRect();
+    *source = options.sourceRect.isValid() ? options.sourceRect : sceneRect;
+    const QSize outputSize = (source->size() * options.scale).toSize();
+    if (outputSize.isEmpty())
+        m_errorString = translate("导出区域为空。");
+    return outputSize;
+}
+
+bool DraftExporter::renderStrips(const Options &options, QImage::Format format, const StripSink &sink)
+{
+    QRectF source;
+    const QSize outputSize = outputSizeFor(options, &source);
+    if (outputSize.isEmpty())
+        return false;
+
+    // 条带缓冲区只有 stripHeight 行，大小与画布高度无关
+    const int stripHeight = qMax(1, qMin(options.stripHeight, outputSize.height()));
+    QImage strip(outputSize.width(), stripHeight, QImage::Format_ARGB32_Premultiplied);
+    if (strip.isNull()) {
+        m_errorString = translate("无法分配导出缓冲区。");
+        return false;
+    }
+
+    const int stripCount = (outputSize.height() + stripHeight - 1) / stripHeight;
+    for (int y = 0; y < outputSize.height(); y += stripHeight) {
+        const int rows = qMin(stripHeight, outputSize.height() - y);
+        strip.fill(options.background);
+
+        // 条带在场景中对应的源区域，与输出像素行严格对齐，避免接缝
+        const QRectF target(0, 0, outputSize.width(), rows);
+        const QRectF stripSource(source.left(), source.top() + y / options.scale,
+                                 source.width(), rows / options.scale);
+
+        QPainter painter(&strip);
+        painter.setRenderHint(QPainter::Antialiasing);
+        painter.setRenderHint(QPainter::SmoothPixmapTransform);
+        renderStrip(&painter, target, stripSource);
+        painter.end();
+
+        if (!sink(strip.convertToFormat(format), y, rows))
+            return false;
+
+        if (options.progress && !options.progress(y / stripHeight + 1, stripCount)) {
+            m_cancelled = true;
+            m_errorString = translate("导出已取消。");
+            return false;
+        }
+    }
+    return true;
+}
+
+QImage DraftExporter::render(const Options &options)
+{
+    m_errorString.clear();
+    m_cancelled = false;
+
+    QRectF source;
+    const QSize outputSize = outputSizeFor(options, &source);
+    if (outputSize.isEmpty())
+        return QImage();
+
+    // 背景不透明时输出 RGB888，每像素 3 字节，比整幅 ARGB QPixmap 少四分之一
+    const bool opaque = options.background.alpha() == 255;
+    QImage output(outputSize, opaque ? QImage::Format_RGB888 : QImage::Format_ARGB32);
+    if (output.isNull()) {
+        m_errorString = translate("画布过大，无法分配 %1 x %2 的图像。")
+                            .arg(outputSize.width()).arg(outputSize.height());
+        return QImage();
+    }
+
+    // 转换为输出格式后逐行拷贝到输出图像
+    const bool ok = renderStrips(options, output.format(), [&output](const QImage &strip, int y, int rows) {
+        const qsizetype lineBytes = qMin(strip.bytesPerLine(), output.bytesPerLine());
+        for (int row = 0; row < rows; ++row) {
+            memcpy(output.scanLine(y + row), strip.constScanLine(row), lineBytes);
+        }
+        return true;
+    });
+    return ok ? output : QImage();
+}
+
+bool DraftExporter::exportTo(const QString &fileName, const Options &options)
+{
+    if (!canStream(fileName, options)) {
+        const QImage image = render(options);
+        if (image.isNull())
+            return false;
+        return write(image, fileName, options, &m_errorString);
+    }
+
+    m_errorString.clear();
+    m_cancelled = false;
+
+    QRectF source;
+    const QSize outputSize = outputSizeFor(options, &source);
+    if (outputSize.isEmpty())
+        return false;
+
+    // 边渲染边编码：每个条带转换为编码器的行格式后直接写盘，失败或取消时删除不完整的文件
+    StreamingImageWriter writer(fileName, resolveFormat(fileName, options), options.quality);
+    if (!writer.begin(outputSize, options.background.alpha() != 255)) {
+        m_errorString = writer.errorString();
+        return false;
+    }
+    const bool rendered = renderStrips(options, writer.rowFormat(), [&writer](const QImage &strip, int, int rows) {
+        return writer.writeRows(strip, rows);
+    });
+    if (!rendered || !writer.finish()) {
+        if (m_errorString.isEmpty())
+            m_errorString = writer.errorString();
+        writer.abort();
+        return false;
+    }
+    return true;
+}
+
+bool DraftExporter::write(const QImage &image, const QString &fileName, const Options &options,
+                          QString *errorString)
+{
+    QImageWriter writer(fileName, options.format);
+    if (options.quality >= 0)
+        writer.setQuality(options.quality);
+    if (!writer.write(image)) {
+        if (errorString)
+            *errorString = writer.errorString();
+        return false;
+    }
+    return true;
+}
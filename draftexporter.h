@@ -0,0 +1,78 @@
+#ifndef DRAFTEXPORTER_H
+#define DRAFTEXPORTER_H
+
+#include <QRectF>
+#include <QSize>
+#include <QColor>
+#include <QString>
+#include <QByteArray>
+#include <QImage>
+
+#include "scenesnapshot.h"
+
+#include <functional>
+
+class QGraphicsScene;
+class QPainter;
+
+// 分条带导出草稿：场景每次只渲染 stripHeight 行到一块小的 QImage 中。
+// BMP 和 PNG（需要 zlib）由 StreamingImageWriter 逐条带编码写盘，内存占用只有条带大小；
+// 其他格式先逐行拷贝进整幅输出图像（背景不透明时为每像素 3 字节的 RGB888），
+// 再由 QImageWriter 一次编码。
+// 基于 SceneSnapshot 构造时不访问场景，可以在工作线程中运行。
+class DraftExporter
+{
+public:
+    // 每完成一个条带回调一次，返回 false 表示取消
+    using ProgressCallback = std::function<bool(int done, int total)>;
+
+    struct Options {
+        QRectF sourceRect;              // 场景坐标下的导出区域
+        qreal scale = 1.0;              // 输出像素 / 场景单位
+        QByteArray format;              // 为空时根据文件后缀推断
+        int quality = -1;               // 传给 QImageWriter，-1 为默认
+        QColor background = Qt::white;
+        int stripHeight = 512;          // 每个条带的像素行数
+        ProgressCallback progress;
+    };
+
+    explicit DraftExporter(QGraphicsScene *scene);
+    explicit DraftExporter(const SceneSnapshot &snapshot);
+
+    // 渲染并写入文件，失败时返回 false，可通过 errorString() 获取原因。
+    // 可以逐行写出的格式边渲染边编码，不分配整幅输出图像
+    bool exportTo(const QString &fileName, const Options &options);
+    // 只渲染，不编码；取消或失败时返回空图像
+    QImage render(const Options &options);
+    // 导出到 fileName 时能否边渲染边编码
+    static bool canStream(const QString &fileName, const Options &options);
+    // 为 outputSize 的输出分配的缓冲区总字节数：条带及其格式转换副本，
+    // 不能逐行写出时再加上整幅输出图像
+    static qint64 renderBufferBytes(const QSize &outputSize, const Options &options, bool streaming = false);
+    // 只编码，可在任意线程中调用
+    static bool write(const QImage &image, const QString &fileName, const Options &options,
+                      QString *errorString = nullptr);
+
+    // 可见顶层项的紧凑外接矩形（已对齐到整数像素），四周加 padding；没有内容时为空
+    static QRectF contentRect(QGraphicsScene *scene, bool selectedOnly = false, qreal padding = 0);
+
+    QString errorString() const { return m_errorString; }
+    bool wasCancelled() const { return m_cancelled; }
+
+private:
+    // 每个条带转换为 format 后交给 sink(strip, y, rows)，sink 返回 false 时停止
+    using StripSink = std::function<bool(const QImage &strip, int y, int rows)>;
+
+    static QByteArray resolveFormat(const QString &fileName, const Options &options);
+    // 导出区域对应的输出尺寸，为空时设置错误信息
+    QSize outputSizeFor(const Options &options, QRectF *source);
+    bool renderStrips(const Options &options, QImage::Format format, const StripSink &sink);
+    void renderStrip(QPainter *painter, const QRectF &target, const QRectF &source);
+
+    QGraphicsScene *m_scene;
+    SceneSnapshot m_snapshot;
+    QString m_errorString;
+    bool m_cancelled;
+};
+
+#endif // DRAFTEXPORTER_H
@@ -1,5 +1,14 @@
 #include "draftwidget.h"
 #include "resizablepixmapitem.h"
+#include "draftexporter.h"
+#include "tiledpixmapitem.h"
+#include "imagesource.h"
+#include "imageloader.h"
+#include "renderqualitycontroller.h"
+#include "scenetilecache.h"
+#include "sceneindex.h"
+#include "undostack.h"
+#include "draftcommands.h"
 
 #include <QGraphicsScene>
 #include <QGraphicsPixmapItem>
@@ -15,14 +24,59 @@
 #include <QMouseEvent>
 #include <QWheelEvent>
 #include <QTransform>
+#include <QTimer>
+#include <QPainter>
+#include <QScreen>
+#include <QStyleOptionGraphicsItem>
+#include <QSet>
+#include <QtConcurrent>
+#include <QtMath>
+
+#include <algorithm>
+#include <cmath>
+
+// 分块图片的图块超过该时间未绘制且不在视口附近时释放
+const int TILE_IDLE_MS = 30000;
+const int TILE_EVICTION_INTERVAL_MS = 5000;
+// 平滑缩放每帧向目标前进的比例（对数空间）
+const qreal ZOOM_EASING = 0.35;
+// 与目标相差小于该比例时直接到达目标
+const qreal ZOOM_SNAP_RATIO = 0.002;
+// 唤醒时每批恢复像素的时间预算，避免长时间阻塞事件循环
+// 缩放或平移停止多久后检查代理图
+const int PROXY_UPGRADE_DELAY_MS = 150;
+// 控制点边长（视口像素，不随缩放变化）
+const int HANDLE_SIZE = 10;
+// 合并选中项时输出图像长边的上限（像素）
+const int FLATTEN_MAX_SIDE = 16384;
+// 为了不超过选中项合计的内存，合并分辨率最多降到原来的这个比例
+const qreal FLATTEN_MIN_SCALE_FACTOR = 0.5;
 
 DraftWidget::DraftWidget(QWidget *parent)
     : QGraphicsView(parent),
-      m_zoomFactor(1.0)
+      m_zoomFactor(1.0),
+      m_targetZoom(1.0),
+      m_smoothZoom(true),
+      m_tileCache(nullptr),
+      m_hibernating(false),
+      m_batchDepth(0),
+      m_batchIndexGuard(nullptr),
+      m_bulkLoadThreshold(2),
+      m_resizeItem(nullptr),
+      m_resizeHandle(ResizablePixmapItem::TopLeft)
 {
+    // 抗锯齿和平滑变换由绘制质量策略按交互状态切换；
+    // 设置场景时可能已经触发滚动，需要先于 setScene 创建
+    m_renderQuality = new RenderQualityController(this);
+
+    // 缩放和平移停止后再检查是否需要把代理图升级为全分辨率
+    m_proxyUpgradeTimer = new QTimer(this);
+    m_proxyUpgradeTimer->setSingleShot(true);
+    m_proxyUpgradeTimer->setInterval(PROXY_UPGRADE_DELAY_MS);
+    connect(m_proxyUpgradeTimer, &QTimer::timeout, this, &DraftWidget::upgradeVisibleProxies);
+
     m_scene = new QGraphicsScene(this);
     setScene(m_scene);
-    setRenderHint(QPainter::Antialiasing);
     setDragMode(QGraphicsView::RubberBandDrag);
     setAcceptDrops(true);
     setTransformationAnchor(QGraphicsView::AnchorUnderMouse);
@@ -30,27 +84,125 @@ DraftWidget::DraftWidget(QWidget *parent)
 
     // 设置白色背景
     m_scene->setBackgroundBrush(Qt::white);
+
+    m_tileEvictionTimer = new QTimer(this);
+    m_tileEvictionTimer->setInterval(TILE_EVICTION_INTERVAL_MS);
+    connect(m_tileEvictionTimer, &QTimer::timeout, this, &DraftWidget::evictIdleTiles);
+    m_tileEvictionTimer->start();
+
+    m_imageLoader = new ImageLoader(this);
+    connect(m_imageLoader, &ImageLoader::loaded, this, &DraftWidget::onImageLoaded);
+    connect(m_imageLoader, &ImageLoader::compressed, this, &DraftWidget::onPixelsCompressed);
+
+    // 缩放请求按显示器刷新率合并
+    m_zoomTimer = new QTimer(this);
+    m_zoomTimer->setTimerType(Qt::PreciseTimer);
+    connect(m_zoomTimer, &QTimer::timeout, this, &DraftWidget::advanceZoom);
+
+    m_undoStack = new UndoStack(this);
+
+    m_flattenWatcher = new QFutureWatcher<QImage>(this);
+    connect(m_flattenWatcher, &QFutureWatcher<QImage>::finished, this, &DraftWidget::onFlattenRendered);
+
+    m_lastActive.start();
 }
 
 DraftWidget::~DraftWidget()
 {
     // scene由QGraphicsView管理，不需要手动删除
+    // 撤销命令删除持有的项时还需要访问本对象，先于 QObject 子对象清理
+    delete m_undoStack;
+    m_undoStack = nullptr;
+    delete m_batchIndexGuard;
+}
+
+void DraftWidget::beginBatch()
+{
+    if (m_batchDepth++ > 0)
+        return;
+
+    m_batchIndexGuard = new SceneBulkLoadGuard(m_scene);
+    viewport()->setUpdatesEnabled(false);
+}
+
+void DraftWidget::endBatch()
+{
+    Q_ASSERT(m_batchDepth > 0);
+    if (--m_batchDepth > 0)
+        return;
+
+    // 恢复索引方式，BSP 树在下一次查询时重建一次
+    delete m_batchIndexGuard;
+    m_batchIndexGuard = nullptr;
+    viewport()->setUpdatesEnabled(true);
+    viewport()->update();
 }
 
 void DraftWidget::setZoomFactor(qreal factor)
+{
+    // 立即应用，取消尚未完成的合并缩放
+    m_zoomTimer->stop();
+    m_targetZoom = clampZoom(factor);
+    applyZoomFactor(m_targetZoom);
+}
+
+void DraftWidget::requestZoom(qreal factor)
+{
+    // 只记录目标值，由定时器每帧最多应用一次
+    m_targetZoom = clampZoom(factor);
+    if (!m_zoomTimer->isActive()) {
+        QScreen *currentScreen = screen();
+        const qreal refreshRate = currentScreen && currentScreen->refreshRate() > 0 ? currentScreen->refreshRate() : 60.0;
+        m_zoomTimer->setInterval(qMax(1, qRound(1000.0 / refreshRate)));
+        m_zoomTimer->start();
+    }
+}
+
+qreal DraftWidget::clampZoom(qreal factor)
 {
     // 限制缩放范围
     if (factor < 0.1)
         factor = 0.1;
     if (factor > 5.0)
         factor = 5.0;
-        
+    return factor;
+}
+
+void DraftWidget::applyZoomFactor(qreal factor)
+{
+    m_renderQuality->interact();
     m_zoomFactor = factor;
     
     // 应用缩放
     QTransform transform;
     transform.scale(m_zoomFactor, m_zoomFactor);
     setTransform(transform);
+
+    m_proxyUpgradeTimer->start();
+    emit zoomChanged(m_zoomFactor);
+}
+
+void DraftWidget::advanceZoom()
+{
+    if (!m_smoothZoom || qAbs(m_targetZoom / m_zoomFactor - 1.0) < ZOOM_SNAP_RATIO) {
+        m_zoomTimer->stop();
+        if (!qFuzzyCompare(m_targetZoom, m_zoomFactor))
+            applyZoomFactor(m_targetZoom);
+        return;
+    }
+
+    // 在对数空间中缓动，放大和缩小的节奏一致
+    const qreal current = std::log(m_zoomFactor);
+    const qreal target = std::log(m_targetZoom);
+    applyZoomFactor(std::exp(current + (target - current) * ZOOM_EASING));
+}
+
+QRectF DraftWidget::exportRect(ExportRegion region, qreal padding) const
+{
+    if (region == ExportViewport)
+        return QRectF(mapToScene(viewport()->rect()).boundingRect().toAlignedRect());
+
+    return DraftExporter::contentRect(m_scene, region == ExportSelection, padding);
 }
 
 void DraftWidget::pasteImageFromClipboard()
@@ -58,15 +210,23 @@ void DraftWidget::pasteImageFromClipboard()
     const QClipboard *clipboard = QApplication::clipboard();
     const QMimeData *mimeData = clipboard->mimeData();
 
+    if (!mimeData->hasImage() && mimeData->hasUrls()) {
+        // 在文件管理器中复制的多个图片文件
+        addImageFiles(mimeData->urls(), mapToScene(viewport()->rect().center()));
+        return;
+    }
+
     if (mimeData->hasImage()) {
         QImage image = qvariant_cast<QImage>(mimeData->imageData());
         if (!image.isNull()) {
-            // 使用自定义的 ResizablePixmapItem 替代 QGraphicsPixmapItem
-            ResizablePixmapItem *item = new ResizablePixmapItem(QPixmap::fromImage(image));
+            // 使用自定义的 ResizablePixmapItem 替代 QGraphicsPixmapItem，
+            // 重复粘贴同一张图片时共享 PixmapStore 中的像素
+            ResizablePixmapItem *item = new ResizablePixmapItem(image);
             m_scene->addItem(item);
             
             // 将图像放置在视图中心
             item->setPos(mapToScene(viewport()->rect().center()) - QPointF(image.width()/2, image.height()/2));
+            m_undoStack->push(new AddItemsCommand(this, {item}));
             
             // 图像自带选择和移动功能，不需要额外设置
             // item->setFlags(QGraphicsItem::ItemIsSelectable | QGraphicsItem::ItemIsMovable | QGraphicsItem::ItemIsFocusable);
@@ -74,40 +234,46 @@ void DraftWidget::pasteImageFromClipboard()
     }
 }
 
+ResizablePixmapItem *DraftWidget::addPixmap(const QPixmap &pixmap)
+{
+    ResizablePixmapItem *item = new ResizablePixmapItem(pixmap);
+    item->setPos(mapToScene(viewport()->rect().center()) - item->contentRect().center());
+    m_scene->addItem(item);
+    m_undoStack->push(new AddItemsCommand(this, {item}));
+    return item;
+}
+
 void DraftWidget::keyPressEvent(QKeyEvent *event)
 {
     if (event->matches(QKeySequence::Paste)) {
         pasteImageFromClipboard();
         event->accept();
     } else if (event->key() == Qt::Key_Delete) {
-        // 删除选中项 - 简化版，不需要处理连线
-        QList<QGraphicsItem*> selectedItems = m_scene->selectedItems();
-        for (QGraphicsItem *item : selectedItems) {
-            m_scene->removeItem(item);
-            delete item;
-        }
+        deleteSelectedItems();
         event->accept();
     } else {
         QGraphicsView::keyPressEvent(event);
     }
 }
 
+void DraftWidget::deleteSelectedItems()
+{
+    const QList<QGraphicsItem*> selectedItems = m_scene->selectedItems();
+    if (selectedItems.isEmpty())
+        return;
+
+    // 项移出场景后由撤销命令持有，撤销时原样放回
+    m_resizeItem = nullptr;
+    m_undoStack->push(new RemoveItemsCommand(this, selectedItems));
+}
+
 void DraftWidget::wheelEvent(QWheelEvent *event)
 {
-    // 获取当前缩放
-    qreal factor = m_zoomFactor;
-    
-    // 根据滚轮方向调整缩放
-    if (event->angleDelta().y() > 0) {
-        // 放大
-        factor *= 1.1;
-    } else {
-        // 缩小
-        factor /= 1.1;
-    }
-    
-    // 应用新的缩放
-    setZoomFactor(factor);
+    // 按滚动量累积到目标缩放：一格（120）缩放 1.1 倍，
+    // 触控板一帧内的大量细小事件只会合并成一次变换
+    const qreal steps = event->angleDelta().y() / 120.0;
+    if (!qFuzzyIsNull(steps))
+        requestZoom(m_targetZoom * std::pow(1.1, steps));
     
     event->accept();
 }
@@ -128,47 +294,759 @@ void DraftWidget::dropEvent(QDropEvent *event)
     if (mimeData->hasImage()) {
         QImage image = qvariant_cast<QImage>(mimeData->imageData());
         if (!image.isNull()) {
-            ResizablePixmapItem *item = new ResizablePixmapItem(QPixmap::fromImage(image));
+            ResizablePixmapItem *item;
+            if (TiledPixmapItem::shouldTile(image.size())) {
+                item = new TiledPixmapItem(ImageSource::fromImage(image));
+            } else {
+                item = new ResizablePixmapItem(image);
+            }
             m_scene->addItem(item);
             item->setPos(mapToScene(event->position().toPoint()));
+            m_undoStack->push(new AddItemsCommand(this, {item}));
             event->acceptProposedAction();
             return;
         }
     } else if (mimeData->hasUrls()) {
-        QList<QUrl> urlList = mimeData->urls();
-        for (const QUrl &url : urlList) {
-            if (url.isLocalFile()) {
-                QString filePath = url.toLocalFile();
-                QFileInfo fileInfo(filePath);
-                QStringList supportedFormats = {"png", "jpg", "jpeg", "bmp", "gif"};
-                if (supportedFormats.contains(fileInfo.suffix().toLower())) {
-                    QPixmap pixmap(filePath);
-                    if (!pixmap.isNull()) {
-                        ResizablePixmapItem *item = new ResizablePixmapItem(pixmap);
-                        m_scene->addItem(item);
-                        item->setPos(mapToScene(event->position().toPoint()));
+        addImageFiles(mimeData->urls(), mapToScene(event->position().toPoint()));
+        event->acceptProposedAction();
+        return;
+    }
+
+    event->ignore();
+}
+
+void DraftWidget::addImageFiles(const QList<QUrl> &urls, const QPointF &scenePos)
+{
+    // 一次加入多个文件时，全部放入后再重建索引、重绘；
+    // 单个文件直接插入 BSP 树，比切换到 NoIndex 再整棵重建便宜
+    QList<QGraphicsItem*> added;
+    const bool batch = shouldBatch(urls.size());
+    if (batch)
+        beginBatch();
+    for (const QUrl &url : urls) {
+        if (url.isLocalFile()) {
+            QString filePath = url.toLocalFile();
+            QFileInfo fileInfo(filePath);
+            QStringList supportedFormats = {"png", "jpg", "jpeg", "bmp", "gif"};
+            if (supportedFormats.contains(fileInfo.suffix().toLower())) {
+                // 超大图片按需分块解码，不整幅载入；概览图和图块都在线程池中解码，
+                // 完成前显示占位
+                QSharedPointer<ImageSource> source = ImageSource::fromFile(filePath);
+                if (source && TiledPixmapItem::shouldTile(source->size())) {
+                    TiledPixmapItem *item = new TiledPixmapItem(source);
+                    item->setPos(scenePos);
+                    m_scene->addItem(item);
+                    item->preload();
+                    added.append(item);
+                    continue;
+                }
+
+                // 先放入占位项保持原有的顺序和位置，像素在线程池中解码
+                if (source) {
+                    ResizablePixmapItem *item = new ResizablePixmapItem(QPixmap());
+                    // 比屏幕还大的图片只解码屏幕分辨率的代理图，保留原文件用于导出和放大
+                    const QSize proxySize = proxySizeFor(source->size());
+                    if (proxySize.isValid()) {
+                        item->setFullResolutionSource(source);
+                    } else {
+                        item->setPlaceholderSize(source->size());
                     }
+                    item->setPos(scenePos);
+                    m_scene->addItem(item);
+                    added.append(item);
+                    m_pendingLoads.insert(m_imageLoader->load(source, proxySize), item);
                 }
             }
         }
-        event->acceptProposedAction();
+    }
+    if (batch)
+        endBatch();
+
+    // 一次加入的所有文件作为一步撤销
+    if (!added.isEmpty())
+        m_undoStack->push(new AddItemsCommand(this, added));
+}
+
+void DraftWidget::onImageLoaded(quint64 id, const QImage &image)
+{
+    // 占位项可能已被删除
+    ResizablePixmapItem *item = m_pendingLoads.take(id);
+    if (!item)
+        return;
+
+    // 休眠项唤醒：解码失败时保持占位
+    if (item->isParked()) {
+        item->restoreParked(image);
         return;
     }
 
-    event->ignore();
+    if (image.isNull()) {
+        // 全分辨率升级失败时保留代理图，只有占位项才需要移除；
+        // 已被撤销命令移出场景的项由命令负责删除
+        if (item->isPlaceholder() && item->scene() == m_scene) {
+            // 只去掉历史中对该项的引用，其余撤销历史保留
+            m_undoStack->forgetItem(item);
+            detachItem(item);
+            discardItem(item);
+        }
+        return;
+    }
+    item->replacePixmap(QPixmap::fromImage(image));
+
+    // 代理图刚就绪时视图可能已经放大到需要全分辨率
+    if (item->isProxy())
+        m_proxyUpgradeTimer->start();
+}
+
+QSize DraftWidget::proxySizeFor(const QSize &size) const
+{
+    // 以屏幕长边的设备像素数为上限，未超过时返回无效尺寸
+    QScreen *currentScreen = screen();
+    const QSize screenSize = currentScreen ? currentScreen->geometry().size() * currentScreen->devicePixelRatio()
+                                           : QSize(2560, 1440);
+    const int limit = qMax(screenSize.width(), screenSize.height());
+    if (qMax(size.width(), size.height()) <= limit)
+        return QSize();
+    return size.scaled(limit, limit, Qt::KeepAspectRatio);
+}
+
+void DraftWidget::upgradeVisibleProxies()
+{
+    const qreal deviceRatio = devicePixelRatioF();
+    const QList<QGraphicsItem*> visibleItems = items(viewport()->rect());
+    for (QGraphicsItem *visible : visibleItems) {
+        ResizablePixmapItem *item = dynamic_cast<ResizablePixmapItem*>(visible);
+        if (!item || !item->isProxy() || m_pendingLoads.key(item, 0) != 0)
+            continue;
+
+        // 屏幕上每个项坐标单位占用的设备像素超过代理图的像素密度时，解码全分辨率
+        const qreal deviceScale = QStyleOptionGraphicsItem::levelOfDetailFromTransform(
+                                      item->sceneTransform() * viewportTransform()) * deviceRatio;
+        if (deviceScale > item->pixelsPerUnit() * 1.05)
+            m_pendingLoads.insert(m_imageLoader->load(item->imageSource()), item);
+    }
+}
+
+void DraftWidget::scrollContentsBy(int dx, int dy)
+{
+    m_renderQuality->interact();
+    QGraphicsView::scrollContentsBy(dx, dy);
+    m_proxyUpgradeTimer->start();
+}
+
+void DraftWidget::paintEvent(QPaintEvent *event)
+{
+    QElapsedTimer frameTimer;
+    frameTimer.start();
+
+    // 框选时橡皮筋由 QGraphicsView 绘制，此时退回逐项绘制
+    if (m_tileCache && !rubberBandRect().isValid()) {
+        QPainter painter(viewport());
+        painter.setRenderHints(renderHints());
+        m_tileCache->paint(&painter, viewportTransform(), event->rect(), devicePixelRatioF());
+
+        // 选中框和控制点不进入缓存，每帧在前景层绘制
+        painter.setWorldTransform(viewportTransform());
+        drawForeground(&painter, mapToScene(event->rect()).boundingRect());
+
+        // 预先渲染视口四周各半个视口范围内的图块
+        const QRectF visible = mapToScene(viewport()->rect()).boundingRect();
+        m_tileCache->prefetch(visible.adjusted(-visible.width() / 2, -visible.height() / 2,
+                                               visible.width() / 2, visible.height() / 2),
+                              m_zoomFactor, devicePixelRatioF());
+    } else {
+        QGraphicsView::paintEvent(event);
+    }
+
+    m_renderQuality->frameRendered(frameTimer.nsecsElapsed());
+}
+
+void DraftWidget::setTileCacheEnabled(bool enabled)
+{
+    if (enabled == tileCacheEnabled())
+        return;
+
+    if (enabled) {
+        m_tileCache = new SceneTileCache(m_scene, this);
+        connect(m_tileCache, &SceneTileCache::tileReady, this, [this](const QRectF &rect) {
+            viewport()->update(mapFromScene(rect).boundingRect().adjusted(-1, -1, 1, 1));
+        });
+    } else {
+        delete m_tileCache;
+        m_tileCache = nullptr;
+    }
+    viewport()->update();
+}
+
+void DraftWidget::forgetPendingLoad(QGraphicsItem *item)
+{
+    forgetPendingPark(item);
+    for (auto it = m_pendingLoads.begin(); it != m_pendingLoads.end(); ++it) {
+        if (it.value() == item) {
+            m_pendingLoads.erase(it);
+            return;
+        }
+    }
+}
+
+void DraftWidget::forgetPendingPark(QGraphicsItem *item)
+{
+    for (auto it = m_pendingParks.begin(); it != m_pendingParks.end(); ++it) {
+        if (it->item == item) {
+            m_pendingParks.erase(it);
+            return;
+        }
+    }
+}
+
+void DraftWidget::detachItem(QGraphicsItem *item)
+{
+    if (item == m_resizeItem)
+        m_resizeItem = nullptr;
+    if (m_moveItems.contains(item)) {
+        m_moveItems.clear();
+        m_moveStartPositions.clear();
+    }
+    forgetPendingPark(item);
+    // 正在合并的项被移除后合并结果作废，完成时不再访问这些项
+    if (m_flatten.items.contains(dynamic_cast<ResizablePixmapItem*>(item)))
+        m_flatten.items.clear();
+    m_scene->removeItem(item);
+}
+
+void DraftWidget::discardItem(QGraphicsItem *item)
+{
+    forgetPendingLoad(item);
+    delete item;
+}
+
+void DraftWidget::flattenSelection()
+{
+    // 上一次合并的结果还没有处理（transforms 在 onFlattenRendered 中才清空）
+    if (!m_flatten.transforms.isEmpty()) {
+        emit flattenFinished(tr("上一次合并仍在进行"));
+        return;
+    }
+
+    QList<ResizablePixmapItem*> items;
+    qreal scale = 0;
+    qreal zValue = 0;
+    qint64 inputBytes = 0;
+    const QList<QGraphicsItem*> selectedItems = m_scene->selectedItems();
+    for (QGraphicsItem *selected : selectedItems) {
+        ResizablePixmapItem *item = dynamic_cast<ResizablePixmapItem*>(selected);
+        if (!item)
+            continue;
+        // 还没有解码出像素、也没有来源可以重新解码的占位项不参与合并
+        if (item->isPlaceholder() && !item->fullResolutionSource()) {
+            item->setSelected(false);
+            continue;
+        }
+
+        // 项在场景中每单位的原始像素数，代理图按全分辨率来源计算
+        const QSharedPointer<ImageSource> source = item->fullResolutionSource();
+        const qreal pixelsPerUnit = source ? source->size().width() / item->contentRect().width()
+                                           : item->pixelsPerUnit();
+        const qreal sceneScale = qSqrt(qAbs(item->sceneTransform().determinant()));
+        if (sceneScale > 0)
+            scale = qMax(scale, pixelsPerUnit / sceneScale);
+        zValue = items.isEmpty() ? item->zValue() : qMax(zValue, item->zValue());
+        // 需要从来源解码的项按全分辨率估算，其余按内存中的像素
+        const QSharedPointer<ImageSource> full = item->imageSource();
+        inputBytes += full ? qint64(full->size().width()) * full->size().height() * 4 : item->memoryBytes();
+        items.append(item);
+    }
+    if (items.size() < 2 || scale <= 0) {
+        emit flattenFinished(tr("请至少选择两张图片再合并"));
+        return;
+    }
+
+    const QRectF sourceRect = DraftExporter::contentRect(m_scene, true);
+    const qreal longestSide = qMax(sourceRect.width(), sourceRect.height()) * scale;
+    if (longestSide > FLATTEN_MAX_SIDE)
+        scale *= FLATTEN_MAX_SIDE / longestSide;
+
+    DraftExporter::Options options;
+    options.sourceRect = sourceRect;
+    options.background = Qt::transparent;
+
+    // 原来的项合并后仍留在撤销历史中，输出比它们合计还大（例如项之间有大片空白）时
+    // 降低分辨率；要降到一半以下才放得下时拒绝合并，以免明显损失清晰度
+    const qint64 outputBytes = DraftExporter::renderBufferBytes((sourceRect.size() * scale).toSize(), options);
+    if (outputBytes > inputBytes) {
+        const qreal factor = qSqrt(qreal(inputBytes) / outputBytes);
+        if (factor < FLATTEN_MIN_SCALE_FACTOR) {
+            emit flattenFinished(tr("合并后的图片需要 %1 MB 内存，远超选中项合计的 %2 MB，未合并")
+                                     .arg(outputBytes / (1024 * 1024)).arg(inputBytes / (1024 * 1024)));
+            return;
+        }
+        scale *= factor;
+    }
+    options.scale = scale;
+
+    m_flatten = PendingFlatten();
+    m_flatten.items = items;
+    for (ResizablePixmapItem *item : items) {
+        m_flatten.transforms.append(item->sceneTransform());
+    }
+    m_flatten.sourceRect = sourceRect;
+    m_flatten.scale = scale;
+    m_flatten.zValue = zValue;
+
+    // 快照持有所需的像素和来源，工作线程中不再访问场景
+    const SceneSnapshot snapshot = SceneSnapshot::capture(m_scene, true);
+    m_flattenWatcher->setFuture(QtConcurrent::run([snapshot, options]() {
+        DraftExporter exporter(snapshot);
+        QImage image = exporter.render(options);
+        // ARGB32 与预乘格式每像素字节数相同，原地转换为 QPixmap 的原生格式，不再复制一份
+        if (!image.isNull())
+            image.convertTo(QImage::Format_ARGB32_Premultiplied);
+        return image;
+    }));
+}
+
+void DraftWidget::onFlattenRendered()
+{
+    // 从 future 中取走结果而不是复制，之后 fromImage 可以直接接管像素
+    QImage image = m_flattenWatcher->future().takeResult();
+    const PendingFlatten flatten = m_flatten;
+    m_flatten = PendingFlatten();
+
+    if (image.isNull()) {
+        emit flattenFinished(tr("无法分配合并后的图片，未合并"));
+        return;
+    }
+    // 渲染期间项被移除（items 已在 detachItem 中清空）或移动、缩放时结果已经过时
+    bool unchanged = !flatten.items.isEmpty();
+    for (int i = 0; unchanged && i < flatten.items.size(); ++i) {
+        unchanged = flatten.items.at(i)->scene() == m_scene
+                    && flatten.items.at(i)->sceneTransform() == flatten.transforms.at(i);
+    }
+    if (!unchanged) {
+        emit flattenFinished(tr("合并期间图片被修改，已取消合并"));
+        return;
+    }
+
+    ResizablePixmapItem *flattened;
+    if (TiledPixmapItem::shouldTile(image.size())) {
+        flattened = new TiledPixmapItem(ImageSource::fromImage(image));
+    } else {
+        // 合并结果不会与其他项重复，不经过 PixmapStore，避免再复制一份像素
+        flattened = new ResizablePixmapItem(QPixmap::fromImage(std::move(image)));
+    }
+
+    // 与控制点缩放一致，以内容中心为缩放中心，再把左上角对齐到原来的外接矩形
+    const qreal itemScale = 1.0 / flatten.scale;
+    if (!qFuzzyCompare(itemScale, 1.0)) {
+        const QPointF center = flattened->contentRect().center();
+        QTransform transform;
+        transform.translate(center.x(), center.y());
+        transform.scale(itemScale, itemScale);
+        transform.translate(-center.x(), -center.y());
+        flattened->setTransform(transform);
+    }
+    flattened->setPos(flatten.sourceRect.topLeft() - flattened->transform().map(flattened->contentRect().topLeft()));
+    flattened->setZValue(flatten.zValue);
+
+    m_undoStack->push(new FlattenCommand(this, flatten.items, flattened));
+    emit flattenFinished(tr("已将 %1 个项合并为一张图片").arg(flatten.items.size()));
+}
+
+void DraftWidget::bringSelectionToFront()
+{
+    // 按当前的绘制顺序（自底向上）依次排在所有项之上
+    QList<QGraphicsItem*> selectedItems;
+    qreal top = 0;
+    const QList<QGraphicsItem*> allItems = m_scene->items(Qt::AscendingOrder);
+    for (QGraphicsItem *item : allItems) {
+        top = qMax(top, item->zValue());
+        if (item->isSelected())
+            selectedItems.append(item);
+    }
+    if (selectedItems.isEmpty())
+        return;
+
+    QVector<qreal> oldValues;
+    QVector<qreal> newValues;
+    for (int i = 0; i < selectedItems.size(); ++i) {
+        oldValues.append(selectedItems.at(i)->zValue());
+        newValues.append(top + 1 + i);
+    }
+    m_undoStack->push(new ZOrderCommand(selectedItems, oldValues, newValues, tr("置于顶层")));
+}
+
+void DraftWidget::sendSelectionToBack()
+{
+    QList<QGraphicsItem*> selectedItems;
+    qreal bottom = 0;
+    const QList<QGraphicsItem*> allItems = m_scene->items(Qt::AscendingOrder);
+    for (QGraphicsItem *item : allItems) {
+        bottom = qMin(bottom, item->zValue());
+        if (item->isSelected())
+            selectedItems.append(item);
+    }
+    if (selectedItems.isEmpty())
+        return;
+
+    QVector<qreal> oldValues;
+    QVector<qreal> newValues;
+    for (int i = 0; i < selectedItems.size(); ++i) {
+        oldValues.append(selectedItems.at(i)->zValue());
+        newValues.append(bottom - selectedItems.size() + i);
+    }
+    m_undoStack->push(new ZOrderCommand(selectedItems, oldValues, newValues, tr("置于底层")));
+}
+
+qint64 DraftWidget::hibernate()
+{
+    m_hibernating = true;
+
+    // 来自文件的项和分块项直接丢弃像素；其余项在线程池中压缩，完成后才释放 pixmap，
+    // 返回值是预计释放的字节数
+    qint64 freed = 0;
+    const QList<QGraphicsItem*> items = m_scene->items(Qt::AscendingOrder);
+    for (QGraphicsItem *item : items) {
+        ResizablePixmapItem *pixmapItem = dynamic_cast<ResizablePixmapItem*>(item);
+        if (!pixmapItem || pixmapItem->isParked() || pixmapItem->pixmap().isNull())
+            continue;
+        if (pixmapItem->fullResolutionSource() || dynamic_cast<TiledPixmapItem*>(pixmapItem)) {
+            freed += pixmapItem->park();
+        } else {
+            PendingPark pending;
+            pending.item = pixmapItem;
+            pending.pixmap = pixmapItem->pixmap();
+            const QImage image = pending.pixmap.toImage();
+            pending.format = image.format();
+            m_pendingParks.insert(m_imageLoader->compress(image), pending);
+            freed += pixmapItem->memoryBytes();
+        }
+    }
+
+    // 还没有完成的唤醒和全分辨率升级作废，结果回来时不再恢复已休眠的项
+    for (auto it = m_pendingLoads.begin(); it != m_pendingLoads.end();) {
+        if (it.value()->isParked())
+            it = m_pendingLoads.erase(it);
+        else
+            ++it;
+    }
+    return freed;
+}
+
+void DraftWidget::onPixelsCompressed(quint64 id, const QByteArray &data)
+{
+    // 压缩期间项被删除或标签页已被唤醒
+    const PendingPark pending = m_pendingParks.take(id);
+    if (!pending.item || !m_hibernating)
+        return;
+    pending.item->parkCompressed(pending.pixmap, pending.format, data);
+}
+
+void DraftWidget::wake()
+{
+    if (!m_hibernating)
+        return;
+    m_hibernating = false;
+    m_pendingParks.clear();
+
+    // 解压和解码都在线程池中进行，可见的项先提交，切换标签后最先恢复
+    QList<ResizablePixmapItem*> parked;
+    const QList<QGraphicsItem*> visibleItems = items(viewport()->rect());
+    for (QGraphicsItem *item : visibleItems) {
+        ResizablePixmapItem *pixmapItem = dynamic_cast<ResizablePixmapItem*>(item);
+        if (pixmapItem && pixmapItem->isParked())
+            parked.append(pixmapItem);
+    }
+    const QList<QGraphicsItem*> allItems = m_scene->items(Qt::AscendingOrder);
+    for (QGraphicsItem *item : allItems) {
+        ResizablePixmapItem *pixmapItem = dynamic_cast<ResizablePixmapItem*>(item);
+        if (pixmapItem && pixmapItem->isParked() && !parked.contains(pixmapItem))
+            parked.append(pixmapItem);
+    }
+
+    for (ResizablePixmapItem *item : std::as_const(parked)) {
+        if (m_pendingLoads.key(item, 0) != 0)
+            continue;
+        const ResizablePixmapItem::ParkedPixels &pixels = item->parkedPixels();
+        const quint64 id = item->fullResolutionSource()
+                               ? m_imageLoader->load(item->fullResolutionSource(), pixels.size)
+                               : m_imageLoader->decompress(pixels.data, pixels.size, pixels.format,
+                                                           pixels.devicePixelRatio);
+        m_pendingLoads.insert(id, item);
+    }
+}
+
+qint64 DraftWidget::memoryBytes() const
+{
+    qint64 bytes = m_tileCache ? m_tileCache->memoryBytes() : 0;
+    bytes += m_undoStack->memoryBytes();
+    const QList<QGraphicsItem*> items = m_scene->items(Qt::AscendingOrder);
+    for (QGraphicsItem *item : items) {
+        if (ResizablePixmapItem *pixmapItem = dynamic_cast<ResizablePixmapItem*>(item))
+            bytes += pixmapItem->memoryBytes();
+    }
+    return bytes;
+}
+
+qint64 DraftWidget::trimMemory(qint64 bytesToFree)
+{
+    // 图块缓存随时可以重新渲染，最先释放
+    qint64 freed = 0;
+    if (m_tileCache) {
+        freed = m_tileCache->memoryBytes();
+        m_tileCache->clear();
+        if (freed >= bytesToFree)
+            return freed;
+    }
+
+    QList<ResizablePixmapItem*> candidates;
+    const QList<QGraphicsItem*> allItems = m_scene->items(Qt::AscendingOrder);
+    for (QGraphicsItem *item : allItems) {
+        if (ResizablePixmapItem *pixmapItem = dynamic_cast<ResizablePixmapItem*>(item))
+            candidates.append(pixmapItem);
+    }
+    std::sort(candidates.begin(), candidates.end(), [](const ResizablePixmapItem *a, const ResizablePixmapItem *b) {
+        return a->lastPaintedMs() < b->lastPaintedMs();
+    });
+
+    // 可见的项马上又会被绘制，释放后只会重新生成
+    QSet<QGraphicsItem*> visibleItems;
+    if (isVisible()) {
+        const QList<QGraphicsItem*> visible = items(viewport()->rect());
+        visibleItems = QSet<QGraphicsItem*>(visible.begin(), visible.end());
+    }
+
+    for (ResizablePixmapItem *item : candidates) {
+        if (freed >= bytesToFree)
+            break;
+        if (visibleItems.contains(item))
+            continue;
+        freed += item->releaseCaches();
+        if (freed < bytesToFree)
+            freed += downgradeToProxy(item);
+    }
+    return freed;
+}
+
+qint64 DraftWidget::downgradeToProxy(ResizablePixmapItem *item)
+{
+    const QSharedPointer<ImageSource> source = item->fullResolutionSource();
+    if (!source || item->isProxy() || item->pixmap().isNull() || m_pendingLoads.key(item, 0) != 0)
+        return 0;
+
+    const QSize proxySize = proxySizeFor(source->size());
+    if (!proxySize.isValid())
+        return 0;
+
+    m_pendingLoads.insert(m_imageLoader->load(source, proxySize), item);
+    return ResizablePixmapItem::pixmapBytes(item->pixmap()) - qint64(proxySize.width()) * proxySize.height() * 4;
+}
+
+void DraftWidget::evictIdleTiles()
+{
+    // 视口向四周各扩展一个视口大小，范围内的图块视为“附近”而保留
+    const QRectF visible = mapToScene(viewport()->rect()).boundingRect();
+    const QRectF nearby = visible.adjusted(-visible.width(), -visible.height(),
+                                           visible.width(), visible.height());
+
+    const QList<QGraphicsItem*> items = m_scene->items(Qt::AscendingOrder);
+    for (QGraphicsItem *item : items) {
+        if (TiledPixmapItem *tiled = dynamic_cast<TiledPixmapItem*>(item)) {
+            const QRectF keepRect = isVisible() ? tiled->mapFromScene(nearby).boundingRect() : QRectF();
+            tiled->evictIdleTiles(TILE_IDLE_MS, keepRect);
+        }
+    }
+    // 不支持局部解码的图片的整幅解码只用于切出图块，同样按空闲时间释放
+    ImageSource::releaseDecodedCache(TILE_IDLE_MS);
+}
+
+QVector<QRectF> DraftWidget::handleRects(const ResizablePixmapItem *item) const
+{
+    const QRectF rect = item->contentRect();
+    const QTransform toViewport = item->sceneTransform() * viewportTransform();
+    const QPointF corners[4] = {
+        toViewport.map(rect.topLeft()),
+        toViewport.map(rect.topRight()),
+        toViewport.map(rect.bottomLeft()),
+        toViewport.map(rect.bottomRight())
+    };
+
+    // 控制点位于角的内侧
+    QVector<QRectF> rects;
+    rects.reserve(4);
+    for (int handle = ResizablePixmapItem::TopLeft; handle <= ResizablePixmapItem::BottomRight; ++handle) {
+        QRectF handleRect(corners[handle], QSizeF(HANDLE_SIZE, HANDLE_SIZE));
+        if (handle == ResizablePixmapItem::TopRight || handle == ResizablePixmapItem::BottomRight)
+            handleRect.moveRight(corners[handle].x());
+        if (handle == ResizablePixmapItem::BottomLeft || handle == ResizablePixmapItem::BottomRight)
+            handleRect.moveBottom(corners[handle].y());
+        rects.append(handleRect);
+    }
+    return rects;
+}
+
+ResizablePixmapItem *DraftWidget::handleAt(const QPoint &pos, int *handle) const
+{
+    // 只有选中项才显示控制点，遍历选中集合即可
+    const QList<QGraphicsItem*> selectedItems = m_scene->selectedItems();
+    for (QGraphicsItem *selected : selectedItems) {
+        ResizablePixmapItem *item = dynamic_cast<ResizablePixmapItem*>(selected);
+        if (!item)
+            continue;
+        const QVector<QRectF> rects = handleRects(item);
+        for (int i = 0; i < rects.size(); ++i) {
+            if (rects.at(i).contains(pos)) {
+                *handle = i;
+                return item;
+            }
+        }
+    }
+    return nullptr;
+}
+
+void DraftWidget::drawForeground(QPainter *painter, const QRectF &rect)
+{
+    QGraphicsView::drawForeground(painter, rect);
+
+    const QList<QGraphicsItem*> selectedItems = m_scene->selectedItems();
+    if (selectedItems.isEmpty())
+        return;
+
+    // 在视口坐标中绘制，控制点大小不随缩放变化
+    painter->save();
+    painter->resetTransform();
+    painter->setRenderHint(QPainter::Antialiasing, false);
+    const QPen outlinePen(Qt::blue, 0, Qt::DashLine);
+    const QPen handlePen(Qt::white, 1);
+
+    for (QGraphicsItem *selected : selectedItems) {
+        ResizablePixmapItem *item = dynamic_cast<ResizablePixmapItem*>(selected);
+        if (!item || !item->isVisible())
+            continue;
+
+        const QTransform toViewport = item->sceneTransform() * viewportTransform();
+        painter->setPen(outlinePen);
+        painter->setBrush(Qt::NoBrush);
+        painter->drawPolygon(toViewport.map(QPolygonF(item->contentRect())));
+
+        painter->setPen(handlePen);
+        painter->setBrush(Qt::blue);
+        for (const QRectF &handleRect : handleRects(item)) {
+            painter->drawRect(handleRect);
+        }
+    }
+    painter->restore();
+}
+
+void DraftWidget::resizeTo(const QPointF &scenePos)
+{
+    const QPointF delta = scenePos - m_resizeStartScenePos;
+    const QRectF rect = m_resizeItem->contentRect();
+
+    // 左侧和上侧控制点向外拖动时坐标减小
+    qreal dx = delta.x();
+    qreal dy = delta.y();
+    if (m_resizeHandle == ResizablePixmapItem::TopLeft || m_resizeHandle == ResizablePixmapItem::BottomLeft)
+        dx = -dx;
+    if (m_resizeHandle == ResizablePixmapItem::TopLeft || m_resizeHandle == ResizablePixmapItem::TopRight)
+        dy = -dy;
+
+    // 在起始缩放的基础上使用平均缩放比例实现等比例缩放
+    const qreal startScale = m_resizeStartTransform.m11();
+    const qreal scale = qMax(0.05, startScale + (dx / rect.width() + dy / rect.height()) / 2.0);
+
+    QPointF center = rect.center();
+    QTransform transform;
+    transform.translate(center.x(), center.y());
+    transform.scale(scale, scale);
+    transform.translate(-center.x(), -center.y());
+    m_resizeItem->setTransform(transform);
 }
 
 void DraftWidget::mousePressEvent(QMouseEvent *event)
 {
+    if (event->button() == Qt::LeftButton) {
+        int handle = 0;
+        if (ResizablePixmapItem *item = handleAt(event->pos(), &handle)) {
+            m_resizeItem = item;
+            m_resizeHandle = handle;
+            m_resizeStartScenePos = mapToScene(event->pos());
+            m_resizeStartTransform = item->transform();
+            event->accept();
+            return;
+        }
+    }
     QGraphicsView::mousePressEvent(event);
+
+    // 拖动项时 Qt 会移动所有选中项，记录起始位置，松开时作为一步撤销
+    QGraphicsItem *grabber = m_scene->mouseGrabberItem();
+    if (event->button() == Qt::LeftButton && grabber && grabber->flags().testFlag(QGraphicsItem::ItemIsMovable)) {
+        m_moveItems = m_scene->selectedItems();
+        if (!m_moveItems.contains(grabber))
+            m_moveItems.append(grabber);
+        m_moveStartPositions.clear();
+        m_moveStartPositions.reserve(m_moveItems.size());
+        for (QGraphicsItem *item : m_moveItems) {
+            m_moveStartPositions.append(item->pos());
+        }
+    }
 }
 
 void DraftWidget::mouseMoveEvent(QMouseEvent *event)
 {
+    if (m_resizeItem) {
+        m_renderQuality->interact();
+        resizeTo(mapToScene(event->pos()));
+        event->accept();
+        return;
+    }
+
+    // 拖动图片或框选时使用快速绘制
+    if (event->buttons() != Qt::NoButton)
+        m_renderQuality->interact();
     QGraphicsView::mouseMoveEvent(event);
+
+    // 悬停在控制点上时显示缩放光标
+    if (event->buttons() == Qt::NoButton) {
+        int handle = 0;
+        if (handleAt(event->pos(), &handle)) {
+            const bool forward = handle == ResizablePixmapItem::TopLeft || handle == ResizablePixmapItem::BottomRight;
+            viewport()->setCursor(forward ? Qt::SizeFDiagCursor : Qt::SizeBDiagCursor);
+        } else {
+            viewport()->unsetCursor();
+        }
+    }
 }
 
 void DraftWidget::mouseReleaseEvent(QMouseEvent *event)
 {
+    if (m_resizeItem && event->button() == Qt::LeftButton) {
+        if (m_resizeItem->transform() != m_resizeStartTransform) {
+            m_undoStack->push(new TransformItemsCommand({m_resizeItem}, {m_resizeStartTransform},
+                                                        {m_resizeItem->transform()}));
+        }
+        m_resizeItem = nullptr;
+        m_proxyUpgradeTimer->start();
+        event->accept();
+        return;
+    }
     QGraphicsView::mouseReleaseEvent(event);
-} 
\ No newline at end of file
+
+    if (!m_moveItems.isEmpty() && event->buttons() == Qt::NoButton) {
+        // 只记录实际移动了的项
+        QList<QGraphicsItem*> moved;
+        QVector<QPointF> oldPositions;
+        QVector<QPointF> newPositions;
+        for (int i = 0; i < m_moveItems.size(); ++i) {
+            QGraphicsItem *item = m_moveItems.at(i);
+            if (item->pos() != m_moveStartPositions.at(i)) {
+                moved.append(item);
+                oldPositions.append(m_moveStartPositions.at(i));
+                newPositions.append(item->pos());
+            }
+        }
+        m_moveItems.clear();
+        m_moveStartPositions.clear();
+        if (!moved.isEmpty())
+            m_undoStack->push(new MoveItemsCommand(moved, oldPositions, newPositions));
+    }
+}
\ No newline at end of file
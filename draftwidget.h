@@ -3,6 +3,10 @@
 
 #include <QGraphicsView>
 #include <QGraphicsScene>
+#include <QHash>
+#include <QElapsedTimer>
+#include <QFutureWatcher>
+#include <QImage>
 // #include <QGraphicsLineItem>  // 可以删除因为不再需要连线
 
 // Forward declarations
@@ -10,6 +14,14 @@ class QKeyEvent;
 class QDragEnterEvent;
 class QDropEvent;
 class QGraphicsItem;
+class QTimer;
+class ResizablePixmapItem;
+class ImageLoader;
+class RenderQualityController;
+class SceneTileCache;
+class SceneBulkLoadGuard;
+class UndoStack;
+class QUrl;
 
 // 删除整个 ConnectionLine 类
 
@@ -18,16 +30,91 @@ class DraftWidget : public QGraphicsView
     Q_OBJECT
 
 public:
+    // 导出区域
+    enum ExportRegion {
+        ExportContent,      // 所有可见图片的紧凑外接矩形
+        ExportSelection,    // 仅选中的图片
+        ExportViewport      // 当前视口可见的场景区域
+    };
+
     explicit DraftWidget(QWidget *parent = nullptr);
     ~DraftWidget() override;
 
     void pasteImageFromClipboard();
+    // 把 pixmap 直接放到视图中心（可撤销），与调用方共享像素，不经过剪贴板和格式转换
+    ResizablePixmapItem *addPixmap(const QPixmap &pixmap);
+    // 删除所有选中项
+    void deleteSelectedItems();
+    // 在 scenePos 处依次加入图片文件，不支持的文件被忽略
+    void addImageFiles(const QList<QUrl> &urls, const QPointF &scenePos);
+
+    // 批量操作：beginBatch 与 endBatch 之间暂停场景索引更新和视口重绘，
+    // endBatch 时只重建一次索引、重绘一次。可以嵌套，以最外层为准
+    void beginBatch();
+    void endBatch();
+    // 一次加入或移除 itemCount 个项时是否值得使用批量操作
+    bool shouldBatch(int itemCount) const { return itemCount >= m_bulkLoadThreshold; }
+    void setBulkLoadThreshold(int threshold) { m_bulkLoadThreshold = qMax(2, threshold); }
+
+    // 本草稿的撤销栈
+    UndoStack *undoStack() const { return m_undoStack; }
+    // 把选中的项按当前变换栅格化为一个新项并替换它们（可撤销）。
+    // 分辨率取选中项中最高的像素密度，输出超过选中项合计的内存时降低分辨率或拒绝合并。
+    // 在后台线程中渲染，结束时发出 flattenFinished
+    void flattenSelection();
+    // 选中项置于顶层/底层（可撤销），保持选中项之间原有的上下顺序
+    void bringSelectionToFront();
+    void sendSelectionToBack();
+    // 供撤销命令使用：把项移出场景但不删除
+    void detachItem(QGraphicsItem *item);
+    // 供撤销命令使用：删除已移出场景、不会再恢复的项
+    void discardItem(QGraphicsItem *item);
     QGraphicsScene* scene() const { return m_scene; }
     QRectF sceneRect() const { return m_scene->sceneRect(); }
     
-    // 设置缩放系数
+    // 设置缩放系数，立即生效
     void setZoomFactor(qreal factor);
     qreal zoomFactor() const { return m_zoomFactor; }
+    // 请求缩放到 factor：多次请求合并，每个显示帧最多变换一次，
+    // 开启平滑缩放时逐帧缓动到目标
+    void requestZoom(qreal factor);
+    qreal targetZoomFactor() const { return m_targetZoom; }
+    void setSmoothZoom(bool enabled) { m_smoothZoom = enabled; }
+    bool smoothZoom() const { return m_smoothZoom; }
+
+    // 本草稿的绘制质量策略（交互时快速绘制，静止后高质量）
+    RenderQualityController *renderQuality() const { return m_renderQuality; }
+
+    // 图块缓存绘制模式：工作线程预先渲染视口周围的场景图块，平移和缩放时直接拼接
+    void setTileCacheEnabled(bool enabled);
+    bool tileCacheEnabled() const { return m_tileCache != nullptr; }
+
+    // 计算导出区域（场景坐标，已对齐到整数像素），没有内容时返回空矩形
+    QRectF exportRect(ExportRegion region, qreal padding = 0) const;
+
+    // 关联的草稿文件路径，未保存过时为空
+    QString filePath() const { return m_filePath; }
+    void setFilePath(const QString &filePath) { m_filePath = filePath; }
+
+    // 休眠：压缩所有项的像素以释放内存，几何和选择状态保持不变；返回大约释放的字节数
+    qint64 hibernate();
+    // 唤醒：立即恢复视口中可见的项，其余的项在事件循环中分批恢复
+    void wake();
+    bool isHibernating() const { return m_hibernating; }
+    // 所有项持有的内存（像素、降采样层级、图块缓存和休眠数据）
+    qint64 memoryBytes() const;
+    // 按最久未绘制的顺序释放缓存、把全分辨率大图退回代理图，
+    // 直到释放 bytesToFree 字节；视口中可见的项不受影响。返回释放的字节数
+    qint64 trimMemory(qint64 bytesToFree);
+    // 标记为刚刚使用过，inactiveMs 从此刻重新计时
+    void markActive() { m_lastActive.start(); }
+    qint64 inactiveMs() const { return m_lastActive.elapsed(); }
+
+signals:
+    // 实际应用的缩放系数变化（平滑缩放时每帧一次）
+    void zoomChanged(qreal factor);
+    // 合并选中项结束（完成、拒绝或被取消），message 为给用户的说明
+    void flattenFinished(const QString &message);
 
 protected:
     void keyPressEvent(QKeyEvent *event) override;
@@ -37,12 +124,90 @@ protected:
     void mouseMoveEvent(QMouseEvent *event) override;
     void mouseReleaseEvent(QMouseEvent *event) override;
     void wheelEvent(QWheelEvent *event) override;
+    // 在前景层一次性绘制所有选中项的边框和控制点
+    void drawForeground(QPainter *painter, const QRectF &rect) override;
+    void scrollContentsBy(int dx, int dy) override;
+    void paintEvent(QPaintEvent *event) override;
     // 确认 eventFilter 声明已删除
     // bool eventFilter(QObject *watched, QEvent *event) override;
 
+private slots:
+    // 释放长时间位于视口之外的分块图片图块
+    void evictIdleTiles();
+    // 异步解码完成，用真实像素替换占位项
+    void onImageLoaded(quint64 id, const QImage &image);
+    // 视口中放大超过代理图分辨率的项改为解码全分辨率
+    void upgradeVisibleProxies();
+    // 休眠项的像素在工作线程中压缩完成
+    void onPixelsCompressed(quint64 id, const QByteArray &data);
+    // 每帧应用一次累积的缩放请求
+    void advanceZoom();
+    // 合并图像渲染完成，用它替换原来的项
+    void onFlattenRendered();
+
 private:
+    static qreal clampZoom(qreal factor);
+    void applyZoomFactor(qreal factor);
+    void forgetPendingLoad(QGraphicsItem *item);
+    void forgetPendingPark(QGraphicsItem *item);
+    // 导入时的代理图尺寸，图片不超过屏幕分辨率时返回无效尺寸
+    QSize proxySizeFor(const QSize &size) const;
+    // 已升级为全分辨率的大图重新解码为代理图，返回预计释放的字节数
+    qint64 downgradeToProxy(ResizablePixmapItem *item);
+    // 选中项四角控制点在视口坐标中的矩形，顺序与 ResizablePixmapItem::HandlePosition 一致
+    QVector<QRectF> handleRects(const ResizablePixmapItem *item) const;
+    // 视口坐标 pos 处的控制点，没有时返回 nullptr
+    ResizablePixmapItem *handleAt(const QPoint &pos, int *handle) const;
+    void resizeTo(const QPointF &scenePos);
+
     QGraphicsScene *m_scene;
     qreal m_zoomFactor;
+    qreal m_targetZoom;
+    bool m_smoothZoom;
+    QTimer *m_zoomTimer;
+    RenderQualityController *m_renderQuality;
+    SceneTileCache *m_tileCache;
+    QString m_filePath;
+    QTimer *m_tileEvictionTimer;
+    ImageLoader *m_imageLoader;
+    QHash<quint64, ResizablePixmapItem*> m_pendingLoads; // 请求 id -> 占位项或待升级的代理项
+    QTimer *m_proxyUpgradeTimer;
+    bool m_hibernating;
+    // 正在压缩像素、等待休眠的项，以及提交压缩时的像素和格式
+    struct PendingPark {
+        ResizablePixmapItem *item = nullptr;
+        QPixmap pixmap;
+        QImage::Format format = QImage::Format_Invalid;
+    };
+    QHash<quint64, PendingPark> m_pendingParks; // 压缩请求 id -> 等待休眠的项
+    QElapsedTimer m_lastActive;
+    UndoStack *m_undoStack;
+
+    // 正在后台渲染的合并：开始时各项的场景变换，完成时不一致说明期间被修改过
+    struct PendingFlatten {
+        QList<ResizablePixmapItem*> items;
+        QVector<QTransform> transforms;
+        QRectF sourceRect;
+        qreal scale = 1.0;
+        qreal zValue = 0;
+    };
+    PendingFlatten m_flatten;
+    QFutureWatcher<QImage> *m_flattenWatcher;
+
+    // 批量操作状态
+    int m_batchDepth;
+    SceneBulkLoadGuard *m_batchIndexGuard;
+    int m_bulkLoadThreshold;
+
+    // 拖动移动状态：被拖动的项及其起始位置，松开时生成一条移动命令
+    QList<QGraphicsItem*> m_moveItems;
+    QVector<QPointF> m_moveStartPositions;
+
+    // 控制点拖动缩放状态
+    ResizablePixmapItem *m_resizeItem;
+    int m_resizeHandle;
+    QPointF m_resizeStartScenePos;
+    QTransform m_resizeStartTransform;
     
     // 删除所有连线相关的成员变量
     // bool m_isDrawingLine;
@@ -0,0 +1,178 @@
+#include "exportbenchmark.h"
+#include "draftexporter.h"
+#include "resizablepixmapitem.h"
+
+#include <QCoreApplication>
+#include <QGraphicsScene>
+#include <QPixmap>
+#include <QImage>
+#include <QPainter>
+#include <QProcess>
+#include <QTemporaryDir>
+#include <QElapsedTimer>
+#include <QTextStream>
+
+#include <cstring>
+
+#if defined(Q_OS_WIN)
+#include <windows.h>
+#include <psapi.h>
+#elif defined(Q_OS_UNIX)
+#include <sys/resource.h>
+#endif
+
+static const char *kBenchmarkFlag = "--benchmark-export";
+static const char *kCaseFlag = "--benchmark-export-case";
+
+// 当前进程的峰值常驻内存（KB），不支持的平台返回 -1
+static qint64 peakResidentKb()
+{
+#if defined(Q_OS_WIN)
+    PROCESS_MEMORY_COUNTERS counters;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+        return qint64(counters.PeakWorkingSetSize / 1024);
+    return -1;
+#elif defined(Q_OS_UNIX)
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+        return -1;
+#if defined(Q_OS_DARWIN)
+    return qint64(usage.ru_maxrss / 1024); // macOS 上单位为字节
+#else
+    return qint64(usage.ru_maxrss);
+#endif
+#else
+    return -1;
+#endif
+}
+
+static QSize parseSize(const QString &text)
+{
+    const QStringList parts = text.split('x');
+    if (parts.size() != 2)
+        return QSize();
+    return QSize(parts.at(0).toInt(), parts.at(1).toInt());
+}
+
+// 用共享同一张 1000x1000 图片的项铺满场景，模拟拼接的长图草稿
+static void populateScene(QGraphicsScene *scene, const QSize &size)
+{
+    QImage tile(1000, 1000, QImage::Format_RGB32);
+    for (int y = 0; y < tile.height(); ++y) {
+        QRgb *line = reinterpret_cast<QRgb *>(tile.scanLine(y));
+        for (int x = 0; x < tile.width(); ++x) {
+            line[x] = qRgb(x % 256, y % 256, (x + y) % 256);
+        }
+    }
+    const QPixmap pixmap = QPixmap::fromImage(tile);
+
+    for (int y = 0; y < size.height(); y += tile.height()) {
+        for (int x = 0; x < size.width(); x += tile.width()) {
+            ResizablePixmapItem *item = new ResizablePixmapItem(pixmap);
+            item->setPos(x, y);
+            scene->addItem(item);
+        }
+    }
+    scene->setSceneRect(0, 0, size.width(), size.height());
+}
+
+// 子进程：运行单个用例，在 stdout 输出 "成功 耗时ms 起始峰值KB 结束峰值KB 缓冲区KB"
+static int runCase(const QString &mode, const QSize &size)
+{
+    QGraphicsScene scene;
+    populateScene(&scene, size);
+
+    QTemporaryDir dir;
+    // stream 用例写出可以逐行编码的格式，其余用例与界面默认的 JPEG 相同
+    const QString fileName = dir.filePath(mode == "stream"
+                                              ? (DraftExporter::canStream("benchmark.png", DraftExporter::Options())
+                                                     ? "benchmark.png" : "benchmark.bmp")
+                                              : "benchmark.jpg");
+
+    const qint64 startPeak = peakResidentKb();
+    QElapsedTimer timer;
+    timer.start();
+
+    bool ok = false;
+    qint64 bufferBytes = 0; // 导出路径自身分配的图像缓冲，不含编码器内部的开销
+    if (mode == "legacy") {
+        // 与旧版 exportCurrentDraft 相同的整幅 QPixmap 路径
+        QPixmap pixmap(scene.sceneRect().size().toSize());
+        bufferBytes = qint64(pixmap.width()) * pixmap.height() * pixmap.depth() / 8;
+        pixmap.fill(Qt::white);
+        QPainter painter(&pixmap);
+        painter.setRenderHint(QPainter::Antialiasing);
+        scene.render(&painter);
+        painter.end();
+        ok = pixmap.save(fileName);
+    } else {
+        DraftExporter exporter(&scene);
+        DraftExporter::Options options;
+        options.sourceRect = scene.sceneRect();
+        bufferBytes = DraftExporter::renderBufferBytes(scene.sceneRect().size().toSize(), options,
+                                                       DraftExporter::canStream(fileName, options));
+        ok = exporter.exportTo(fileName, options);
+    }
+
+    QTextStream(stdout) << (ok ? 1 : 0) << ' ' << timer.elapsed() << ' '
+                        << startPeak << ' ' << peakResidentKb() << ' ' << bufferBytes / 1024 << '\n';
+    return ok ? 0 : 1;
+}
+
+bool isExportBenchmarkRequested(int argc, char *argv[])
+{
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], kBenchmarkFlag) == 0 || strcmp(argv[i], kCaseFlag) == 0)
+            return true;
+    }
+    return false;
+}
+
+int runExportBenchmark(const QStringList &arguments)
+{
+    const int caseIndex = arguments.indexOf(QLatin1String(kCaseFlag));
+    if (caseIndex >= 0) {
+        if (caseIndex + 2 >= arguments.size())
+            return 2;
+        return runCase(arguments.at(caseIndex + 1), parseSize(arguments.at(caseIndex + 2)));
+    }
+
+    const QStringList sizes = {QStringLiteral("10000x10000"), QStringLiteral("30000x5000")};
+    const QStringList modes = {QStringLiteral("legacy"), QStringLiteral("tiled"), QStringLiteral("stream")};
+
+    QTextStream err(stderr);
+    // export 是导出过程中峰值 RSS 的增长，包含编码器的开销；buffers 是导出路径自身分配的
+    // 图像缓冲。tiled 写 JPEG，仍需要整幅输出图像；stream 写 PNG（没有 zlib 时为 BMP），
+    // 只有条带缓冲。编码器不同，三者的耗时不能直接比较
+    err << QString("%1 %2 %3 %4 %5 %6\n")
+               .arg("size", -12).arg("mode", -8).arg("wall(ms)", 10)
+               .arg("peak RSS(MB)", 14).arg("export(MB)", 12).arg("buffers(MB)", 12);
+
+    for (const QString &size : sizes) {
+        for (const QString &mode : modes) {
+            QProcess process;
+            process.setProcessChannelMode(QProcess::ForwardedErrorChannel);
+            process.start(QCoreApplication::applicationFilePath(),
+                          {QLatin1String(kCaseFlag), mode, size});
+            process.waitForFinished(-1);
+
+            const QStringList fields = QString::fromLocal8Bit(process.readAllStandardOutput())
+                                           .simplified().split(' ');
+            if (process.exitCode() != 0 || fields.size() != 5) {
+                err << QString("%1 %2 failed\n").arg(size, -12).arg(mode, -8);
+                continue;
+            }
+
+            const qint64 startPeak = fields.at(2).toLongLong();
+            const qint64 endPeak = fields.at(3).toLongLong();
+            err << QString("%1 %2 %3 %4 %5 %6\n")
+                       .arg(size, -12).arg(mode, -8)
+                       .arg(fields.at(1), 10)
+                       .arg(endPeak / 1024, 14)
+                       .arg((endPeak - startPeak) / 1024, 12)
+                       .arg(fields.at(4).toLongLong() / 1024, 12);
+        }
+    }
+    err.flush();
+    return 0;
+}
@@ -0,0 +1,12 @@
+#ifndef EXPORTBENCHMARK_H
+#define EXPORTBENCHMARK_H
+
+#include <QStringList>
+
+// 导出基准测试：对比旧的整幅 QPixmap 导出与条带导出的峰值内存和耗时。
+// 用法：ez-paster --benchmark-export
+// 每个用例在独立子进程中运行，这样峰值 RSS 互不影响。
+bool isExportBenchmarkRequested(int argc, char *argv[]);
+int runExportBenchmark(const QStringList &arguments);
+
+#endif // EXPORTBENCHMARK_H
@@ -0,0 +1,119 @@
+#include "exportjob.h"
+
+#include <QtConcurrent>
+#include <QFile>
+
+// 渲染阶段占总进度的比例，剩余部分留给编码阶段
+static const int kRenderProgressShare = 90;
+
+ExportJob::ExportJob(const SceneSnapshot &snapshot, const QString &fileName,
+                     const DraftExporter::Options &options, QObject *parent)
+    : QObject(parent),
+      m_snapshot(snapshot),
+      m_fileName(fileName),
+      m_options(options),
+      m_cancelRequested(false),
+      m_streaming(DraftExporter::canStream(fileName, options)),
+      m_streamed(false)
+{
+    connect(&m_renderWatcher, &QFutureWatcher<QImage>::finished, this, &ExportJob::onRenderFinished);
+    connect(&m_encodeWatcher, &QFutureWatcher<bool>::finished, this, &ExportJob::onEncodeFinished);
+}
+
+ExportJob::~ExportJob()
+{
+    // 工作线程引用了本对象的成员，必须等它们结束
+    m_cancelRequested = true;
+    m_renderWatcher.waitForFinished();
+    m_encodeWatcher.waitForFinished();
+}
+
+void ExportJob::start()
+{
+    const QString stage = m_streaming ? tr("正在导出") : tr("正在渲染");
+    emit progressChanged(0, stage);
+
+    m_renderWatcher.setFuture(QtConcurrent::run([this, stage]() {
+        DraftExporter exporter(m_snapshot);
+        DraftExporter::Options options = m_options;
+        // 边渲染边写盘时渲染进度就是全部进度
+        const int share = m_streaming ? 100 : kRenderProgressShare;
+        int lastPercent = -1;
+        options.progress = [this, &lastPercent, share, stage](int done, int total) {
+            const int percent = done * share / total;
+            if (percent != lastPercent) {
+                lastPercent = percent;
+                // 跨线程发射信号，接收方在 GUI 线程中以队列方式执行
+                emit progressChanged(percent, stage);
+            }
+            return !m_cancelRequested.load();
+        };
+
+        if (m_streaming) {
+            // 取消或失败时 exportTo 已删除不完整的文件
+            m_streamed = exporter.exportTo(m_fileName, options);
+            if (!m_streamed && !exporter.wasCancelled())
+                m_errorString = exporter.errorString();
+            return QImage();
+        }
+
+        QImage image = exporter.render(options);
+        if (image.isNull() && !exporter.wasCancelled())
+            m_errorString = exporter.errorString();
+        return image;
+    }));
+}
+
+void ExportJob::cancel()
+{
+    m_cancelRequested = true;
+}
+
+void ExportJob::onRenderFinished()
+{
+    // 快照已不再需要，释放对像素数据的引用
+    m_snapshot = SceneSnapshot();
+
+    if (m_cancelRequested) {
+        // 最后一个条带之后才取消时文件已经写完，同样删除
+        if (m_streamed)
+            QFile::remove(m_fileName);
+        emit finished(false, true, QString());
+        return;
+    }
+
+    if (m_streaming) {
+        if (m_streamed)
+            emit progressChanged(100, tr("完成"));
+        emit finished(m_streamed, false, m_streamed ? QString() : m_errorString);
+        return;
+    }
+
+    const QImage image = m_renderWatcher.result();
+    if (image.isNull()) {
+        emit finished(false, false, m_errorString);
+        return;
+    }
+
+    emit progressChanged(kRenderProgressShare, tr("正在编码"));
+
+    m_encodeWatcher.setFuture(QtConcurrent::run([this, image]() {
+        return DraftExporter::write(image, m_fileName, m_options, &m_errorString);
+    }));
+}
+
+void ExportJob::onEncodeFinished()
+{
+    const bool ok = m_encodeWatcher.result();
+
+    // 编码器无法中途打断，取消时删除已经写出的文件
+    if (m_cancelRequested) {
+        QFile::remove(m_fileName);
+        emit finished(false, true, QString());
+        return;
+    }
+
+    if (ok)
+        emit progressChanged(100, tr("完成"));
+    emit finished(ok, false, ok ? QString() : m_errorString);
+}
@@ -0,0 +1,49 @@
+#ifndef EXPORTJOB_H
+#define EXPORTJOB_H
+
+#include <QObject>
+#include <QFutureWatcher>
+#include <QImage>
+
+#include "draftexporter.h"
+#include "scenesnapshot.h"
+
+#include <atomic>
+
+// 后台导出任务：第一阶段在工作线程中把场景快照栅格化为 QImage，
+// 第二阶段在另一个任务中编码写盘。两个阶段都不会阻塞 GUI 线程。
+// 可以逐行写出的格式（见 DraftExporter::canStream）在第一阶段中边渲染边写盘，没有第二阶段。
+class ExportJob : public QObject
+{
+    Q_OBJECT
+
+public:
+    ExportJob(const SceneSnapshot &snapshot, const QString &fileName,
+              const DraftExporter::Options &options, QObject *parent = nullptr);
+    ~ExportJob() override;
+
+    void start();
+    void cancel();
+    QString fileName() const { return m_fileName; }
+
+signals:
+    void progressChanged(int percent, const QString &stage);
+    void finished(bool success, bool cancelled, const QString &errorString);
+
+private slots:
+    void onRenderFinished();
+    void onEncodeFinished();
+
+private:
+    SceneSnapshot m_snapshot;
+    QString m_fileName;
+    DraftExporter::Options m_options;
+    std::atomic<bool> m_cancelRequested;
+    bool m_streaming;
+    bool m_streamed;       // 边渲染边写盘已成功完成，由工作线程写入
+    QString m_errorString; // 由工作线程写入，在 watcher 的 finished 之后读取
+    QFutureWatcher<QImage> m_renderWatcher;
+    QFutureWatcher<bool> m_encodeWatcher;
+};
+
+#endif // EXPORTJOB_H
@@ -0,0 +1,133 @@
+#include "headlessexport.h"
+#include "draftdocument.h"
+#include "draftexporter.h"
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QGraphicsScene>
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QImage>
+#include <QTextStream>
+
+#include <cstring>
+
+static const char *kExportFlag = "--export";
+
+bool isHeadlessExportRequested(int argc, char *argv[])
+{
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], kExportFlag) == 0 || strncmp(argv[i], "--export=", 9) == 0)
+            return true;
+    }
+    return false;
+}
+
+int runHeadlessExport(const QStringList &arguments, qint64 startupMs)
+{
+    QTextStream err(stderr);
+    QElapsedTimer total;
+    total.start();
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(QStringLiteral("EZ Paster headless export"));
+    parser.addHelpOption();
+    const QCommandLineOption exportOption(QStringLiteral("export"),
+                                          QStringLiteral("Draft file to render."), QStringLiteral("draft"));
+    const QCommandLineOption outOption(QStringLiteral("out"),
+                                       QStringLiteral("Output image file."), QStringLiteral("file"));
+    const QCommandLineOption formatOption(QStringLiteral("format"),
+                                          QStringLiteral("Output format: png or jpg."), QStringLiteral("format"));
+    const QCommandLineOption qualityOption(QStringLiteral("quality"),
+                                           QStringLiteral("Encoder quality 0-100."), QStringLiteral("N"), QStringLiteral("-1"));
+    const QCommandLineOption scaleOption(QStringLiteral("scale"),
+                                         QStringLiteral("Output scale factor."), QStringLiteral("S"), QStringLiteral("1"));
+    parser.addOptions({exportOption, outOption, formatOption, qualityOption, scaleOption});
+
+    if (!parser.parse(arguments)) {
+        err << parser.errorText() << '\n';
+        return 2;
+    }
+    if (parser.isSet(QStringLiteral("help"))) {
+        err << parser.helpText();
+        return 0;
+    }
+
+    const QString draftFile = parser.value(exportOption);
+    const QString outFile = parser.value(outOption);
+    if (draftFile.isEmpty() || outFile.isEmpty()) {
+        err << "usage: ez-paster --export <draft> --out <file> [--format png|jpg --quality N --scale S]\n";
+        return 2;
+    }
+
+    DraftExporter::Options options;
+    options.format = parser.value(formatOption).toLower().toLatin1();
+    if (options.format.isEmpty())
+        options.format = QFileInfo(outFile).suffix().toLower().toLatin1();
+    if (options.format == "jpeg")
+        options.format = "jpg";
+    if (options.format != "png" && options.format != "jpg") {
+        err << "unsupported format: " << options.format << '\n';
+        return 2;
+    }
+
+    bool ok = false;
+    options.quality = parser.value(qualityOption).toInt(&ok);
+    if (!ok || options.quality < -1 || options.quality > 100) {
+        err << "invalid quality: " << parser.value(qualityOption) << '\n';
+        return 2;
+    }
+    options.scale = parser.value(scaleOption).toDouble(&ok);
+    if (!ok || options.scale <= 0) {
+        err << "invalid scale: " << parser.value(scaleOption) << '\n';
+        return 2;
+    }
+
+    err << "[ez-paster] startup " << startupMs << " ms\n";
+
+    // 加载：解码草稿中的所有图片
+    QElapsedTimer phase;
+    phase.start();
+    QGraphicsScene scene;
+    scene.setBackgroundBrush(Qt::white);
+    QString errorString;
+    int itemCount = 0;
+    if (!DraftDocument::load(&scene, draftFile, &errorString, &itemCount)) {
+        err << "failed to load " << draftFile << ": " << errorString << '\n';
+        return 1;
+    }
+    err << "[ez-paster] load " << phase.restart() << " ms (" << itemCount << " items)\n";
+
+    // 渲染：与界面导出相同，按内容紧凑区域通过 QGraphicsScene::render 分条带渲染
+    options.sourceRect = DraftExporter::contentRect(&scene);
+    if (options.sourceRect.isEmpty()) {
+        err << "draft is empty: " << draftFile << '\n';
+        return 1;
+    }
+    DraftExporter exporter(&scene);
+    if (DraftExporter::canStream(outFile, options)) {
+        // 逐行写出的格式边渲染边编码，渲染与编码的耗时合在一起
+        if (!exporter.exportTo(outFile, options)) {
+            err << "failed to write " << outFile << ": " << exporter.errorString() << '\n';
+            return 1;
+        }
+        err << "[ez-paster] render+encode " << phase.elapsed() << " ms (streamed)\n";
+        err << "[ez-paster] total " << startupMs + total.elapsed() << " ms\n";
+        return 0;
+    }
+    const QImage image = exporter.render(options);
+    if (image.isNull()) {
+        err << "render failed: " << exporter.errorString() << '\n';
+        return 1;
+    }
+    err << "[ez-paster] render " << phase.restart() << " ms (" << image.width() << 'x' << image.height() << ")\n";
+
+    // 编码
+    if (!DraftExporter::write(image, outFile, options, &errorString)) {
+        err << "failed to write " << outFile << ": " << errorString << '\n';
+        return 1;
+    }
+    err << "[ez-paster] encode " << phase.elapsed() << " ms\n";
+    err << "[ez-paster] total " << startupMs + total.elapsed() << " ms\n";
+    return 0;
+}
@@ -0,0 +1,12 @@
+#ifndef HEADLESSEXPORT_H
+#define HEADLESSEXPORT_H
+
+#include <QStringList>
+
+// 无界面批量导出：
+//   ez-paster --export <draft> --out <file> [--format png|jpg --quality N --scale S]
+// 加载草稿到 QGraphicsScene 后直接渲染导出，不创建 MainWindow，各阶段耗时输出到 stderr。
+bool isHeadlessExportRequested(int argc, char *argv[]);
+int runHeadlessExport(const QStringList &arguments, qint64 startupMs);
+
+#endif // HEADLESSEXPORT_H
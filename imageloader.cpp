@@ -0,0 +1,66 @@
+#include "imageloader.h"
+#include "imagesource.h"
+
+#include <QMetaObject>
+
+ImageLoader::ImageLoader(QObject *parent)
+    : QObject(parent),
+      m_nextId(1)
+{
+}
+
+ImageLoader::~ImageLoader()
+{
+    // 丢弃尚未开始的任务，等待正在解码的任务结束
+    m_pool.clear();
+    m_pool.waitForDone();
+}
+
+quint64 ImageLoader::load(const QSharedPointer<ImageSource> &source, const QSize &scaledSize)
+{
+    const quint64 id = m_nextId++;
+    m_pool.start([this, id, source, scaledSize]() {
+        QImage image = source->read(QRect(), scaledSize);
+        if (!image.isNull()) {
+            // 在工作线程中完成格式转换，GUI 线程上的 fromImage 就不必再转换
+            image = ImageSource::toNativeFormat(image);
+        }
+        QMetaObject::invokeMethod(this, [this, id, image]() {
+            emit loaded(id, image);
+        }, Qt::QueuedConnection);
+    });
+    return id;
+}
+
+quint64 ImageLoader::compress(const QImage &image)
+{
+    const quint64 id = m_nextId++;
+    m_pool.start([this, id, image]() {
+        // 压缩级别 1：速度优先，截图和界面图片通常有大片相同颜色，压缩率已经足够
+        const QByteArray data = qCompress(image.constBits(), int(image.sizeInBytes()), 1);
+        QMetaObject::invokeMethod(this, [this, id, data]() {
+            emit compressed(id, data);
+        }, Qt::QueuedConnection);
+    });
+    return id;
+}
+
+quint64 ImageLoader::decompress(const QByteArray &data, const QSize &size, QImage::Format format,
+                                qreal devicePixelRatio)
+{
+    const quint64 id = m_nextId++;
+    m_pool.start([this, id, data, size, format, devicePixelRatio]() {
+        const QByteArray raw = qUncompress(data);
+        QImage image(size, format);
+        if (image.isNull() || raw.size() != image.sizeInBytes()) {
+            image = QImage();
+        } else {
+            memcpy(image.bits(), raw.constData(), size_t(raw.size()));
+            image.setDevicePixelRatio(devicePixelRatio);
+        }
+        QMetaObject::invokeMethod(this, [this, id, image]() {
+            emit loaded(id, image);
+        }, Qt::QueuedConnection);
+    });
+    return id;
+}
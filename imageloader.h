@@ -0,0 +1,40 @@
+#ifndef IMAGELOADER_H
+#define IMAGELOADER_H
+
+#include <QObject>
+#include <QImage>
+#include <QSize>
+#include <QSharedPointer>
+#include <QThreadPool>
+
+class ImageSource;
+
+// 在线程池中并行解码图像。结果通过 loaded 信号回到 GUI 线程，
+// 图像已转换为 QPixmap 的原生格式，QPixmap::fromImage 无需再复制。
+// 休眠项像素的压缩和解压也在同一线程池中进行。
+class ImageLoader : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit ImageLoader(QObject *parent = nullptr);
+    ~ImageLoader() override;
+
+    // 提交解码请求，scaledSize 有效时由解码器直接缩放；返回请求 id
+    quint64 load(const QSharedPointer<ImageSource> &source, const QSize &scaledSize = QSize());
+    // 压缩 image 的扫描线，结果通过 compressed 信号返回；返回请求 id
+    quint64 compress(const QImage &image);
+    // 解压 compress 的结果，与 load 一样通过 loaded 信号返回；返回请求 id
+    quint64 decompress(const QByteArray &data, const QSize &size, QImage::Format format, qreal devicePixelRatio);
+
+signals:
+    // 解码失败时 image 为空
+    void loaded(quint64 id, const QImage &image);
+    void compressed(quint64 id, const QByteArray &data);
+
+private:
+    QThreadPool m_pool;
+    quint64 m_nextId;
+};
+
+#endif // IMAGELOADER_H
@@ -0,0 +1,178 @@
+#include "imagesource.h"
+
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QHash>
+#include <QImageReader>
+#include <QMutex>
+
+// 整幅解码缓存的上限；更大的图片每次都重新解码，不常驻内存
+const qint64 DECODED_CACHE_BYTES = 256 * 1024 * 1024;
+
+namespace {
+struct DecodedImage {
+    QImage image;
+    qint64 lastUsed = 0;
+};
+
+QMutex s_decodedMutex;
+QHash<QString, DecodedImage> s_decoded;
+qint64 s_decodedBytes = 0;
+
+qint64 decodedClockMs()
+{
+    static QElapsedTimer clock;
+    if (!clock.isValid())
+        clock.start();
+    return clock.elapsed();
+}
+}
+
+QSharedPointer<ImageSource> ImageSource::fromFile(const QString &filePath)
+{
+    QImageReader reader(filePath);
+    const QSize size = reader.size();
+    if (!size.isValid())
+        return QSharedPointer<ImageSource>();
+
+    QSharedPointer<ImageSource> source(new ImageSource);
+    source->m_filePath = filePath;
+    source->m_size = size;
+    const QImage::Format format = reader.imageFormat();
+    source->m_hasAlpha = format == QImage::Format_Invalid
+                         || QImage::toPixelFormat(format).alphaUsage() == QPixelFormat::UsesAlpha;
+    source->m_partialRead = reader.supportsOption(QImageIOHandler::ClipRect);
+    return source;
+}
+
+QSharedPointer<ImageSource> ImageSource::fromImage(const QImage &image)
+{
+    if (image.isNull())
+        return QSharedPointer<ImageSource>();
+
+    QSharedPointer<ImageSource> source(new ImageSource);
+    source->m_image = image;
+    source->m_size = image.size();
+    source->m_hasAlpha = image.hasAlphaChannel();
+    return source;
+}
+
+bool ImageSource::isAvailable() const
+{
+    return !isFileBacked() || QFileInfo(m_filePath).isReadable();
+}
+
+QImage ImageSource::read(const QRect &clip, const QSize &scaledSize) const
+{
+    if (isFileBacked() && !m_partialRead && !clip.isNull()) {
+        // 读取任何区域都要解码整个文件：整幅解码一次，之后各个区域都从缓存中复制
+        const QImage whole = decodeWhole();
+        if (whole.isNull())
+            return QImage();
+        const QImage image = whole.copy(clip);
+        if (scaledSize.isValid() && scaledSize != image.size())
+            return image.scaled(scaledSize, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+        return image;
+    }
+
+    if (isFileBacked()) {
+        // 由解码器处理裁剪和缩放，JPEG 等格式可以只解码需要的部分
+        QImageReader reader(m_filePath);
+        if (!clip.isNull())
+            reader.setClipRect(clip);
+        if (scaledSize.isValid())
+            reader.setScaledSize(scaledSize);
+        return reader.read();
+    }
+
+    const QImage image = clip.isNull() ? m_image : m_image.copy(clip);
+    if (scaledSize.isValid() && scaledSize != image.size())
+        return image.scaled(scaledSize, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+    return image;
+}
+
+QImage ImageSource::decodeWhole() const
+{
+    {
+        QMutexLocker locker(&s_decodedMutex);
+        auto it = s_decoded.find(m_filePath);
+        if (it != s_decoded.end()) {
+            it->lastUsed = decodedClockMs();
+            return it->image;
+        }
+    }
+
+    // 解码在锁外进行，两个线程同时未命中时各自解码一次，只保留先完成的结果
+    const QImage image = QImageReader(m_filePath).read();
+    const qint64 bytes = image.sizeInBytes();
+    if (image.isNull() || bytes > DECODED_CACHE_BYTES)
+        return image;
+
+    QMutexLocker locker(&s_decodedMutex);
+    if (s_decoded.contains(m_filePath))
+        return s_decoded.value(m_filePath).image;
+    // 超出上限时淘汰最久未使用的解码结果
+    while (s_decodedBytes + bytes > DECODED_CACHE_BYTES && !s_decoded.isEmpty()) {
+        auto oldest = s_decoded.begin();
+        for (auto it = s_decoded.begin(); it != s_decoded.end(); ++it) {
+            if (it->lastUsed < oldest->lastUsed)
+                oldest = it;
+        }
+        s_decodedBytes -= oldest->image.sizeInBytes();
+        s_decoded.erase(oldest);
+    }
+    DecodedImage entry;
+    entry.image = image;
+    entry.lastUsed = decodedClockMs();
+    s_decoded.insert(m_filePath, entry);
+    s_decodedBytes += bytes;
+    return image;
+}
+
+qint64 ImageSource::decodedCacheBytes()
+{
+    QMutexLocker locker(&s_decodedMutex);
+    return s_decodedBytes;
+}
+
+qint64 ImageSource::releaseDecodedCache(qint64 maxIdleMs)
+{
+    QMutexLocker locker(&s_decodedMutex);
+    const qint64 now = decodedClockMs();
+    qint64 freed = 0;
+    for (auto it = s_decoded.begin(); it != s_decoded.end();) {
+        if (maxIdleMs < 0 || now - it->lastUsed > maxIdleMs) {
+            freed += it->image.sizeInBytes();
+            it = s_decoded.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    s_decodedBytes -= freed;
+    return freed;
+}
+
+bool ImageSource::isFullyOpaque(const QImage &image)
+{
+    // image 为 ARGB32_Premultiplied，遇到第一个透明像素即返回
+    for (int y = 0; y < image.height(); ++y) {
+        const QRgb *line = reinterpret_cast<const QRgb*>(image.constScanLine(y));
+        for (int x = 0; x < image.width(); ++x) {
+            if (qAlpha(line[x]) != 255)
+                return false;
+        }
+    }
+    return true;
+}
+
+QImage ImageSource::toNativeFormat(const QImage &image)
+{
+    if (!image.hasAlphaChannel())
+        return image.convertToFormat(QImage::Format_RGB32);
+
+    QImage converted = image.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+    // 不透明时两种格式的像素位完全相同，只需改变格式标记
+    if (isFullyOpaque(converted))
+        converted.reinterpretAsFormat(QImage::Format_RGB32);
+    return converted;
+}
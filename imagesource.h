@@ -0,0 +1,57 @@
+#ifndef IMAGESOURCE_H
+#define IMAGESOURCE_H
+
+#include <QImage>
+#include <QRect>
+#include <QSharedPointer>
+#include <QString>
+
+// 可重复读取的图像来源：磁盘文件或内存中的 QImage。
+// 对象创建后不可变，read() 可以在任意线程中并发调用。
+class ImageSource
+{
+public:
+    // 文件无法识别时返回空指针；只读取文件头，不解码像素
+    static QSharedPointer<ImageSource> fromFile(const QString &filePath);
+    static QSharedPointer<ImageSource> fromImage(const QImage &image);
+
+    QSize size() const { return m_size; }
+    QString filePath() const { return m_filePath; }
+    bool isFileBacked() const { return !m_filePath.isEmpty(); }
+    // 文件头或像素格式表明可能含有透明像素；无法判断时按有透明处理
+    bool hasAlphaChannel() const { return m_hasAlpha; }
+    // 来源仍可读取：内存图像总是可用，文件可能已被移动或删除
+    bool isAvailable() const;
+    // 能否只解码一部分：JPEG 等解码器支持裁剪，PNG 读取任何区域都要解码整个文件
+    bool supportsPartialRead() const { return m_partialRead; }
+    // 内存来源的图像，文件来源时为空
+    QImage image() const { return m_image; }
+
+    // 解码 clip 区域（源像素坐标，空矩形表示整幅），scaledSize 有效时缩放到该尺寸。
+    // 不支持局部解码的文件整幅解码后放入全局缓存，接下来读取其他区域时直接从中复制
+    QImage read(const QRect &clip = QRect(), const QSize &scaledSize = QSize()) const;
+
+    // 整幅解码缓存占用的字节数
+    static qint64 decodedCacheBytes();
+    // 释放超过 maxIdleMs 未使用的整幅解码（负数表示全部释放），返回释放的字节数
+    static qint64 releaseDecodedCache(qint64 maxIdleMs = -1);
+
+    // 转换为 QPixmap 的原生格式。带 alpha 通道但所有像素都不透明的图片
+    // （例如经过剪贴板的截图）转换为 RGB32，绘制时不需要混合
+    static QImage toNativeFormat(const QImage &image);
+
+private:
+    static bool isFullyOpaque(const QImage &image);
+    // 不支持局部解码时的整幅解码，优先从缓存中取
+    QImage decodeWhole() const;
+
+    ImageSource() = default;
+
+    QString m_filePath;
+    QImage m_image;
+    QSize m_size;
+    bool m_hasAlpha = true;
+    bool m_partialRead = true;
+};
+
+#endif // IMAGESOURCE_H
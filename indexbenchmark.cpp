@@ -0,0 +1,262 @@
+#include "indexbenchmark.h"
+#include "resizablepixmapitem.h"
+#include "sceneindex.h"
+
+#include <QGraphicsScene>
+#include <QPainterPath>
+#include <QPixmap>
+#include <QImage>
+#include <QElapsedTimer>
+#include <QScopedPointer>
+#include <QRandomGenerator>
+#include <QTextStream>
+#include <QVector>
+#include <QtMath>
+
+#include <cstring>
+
+static const char *kIndexBenchmarkFlag = "--benchmark-index";
+static const char *kSaveFlag = "--save";
+
+// 每项操作的重复次数
+const int SELECTION_ROUNDS = 50;
+const int HIT_TEST_ROUNDS = 1000;
+const int SELECTED_ITEMS_ROUNDS = 100;
+const int MOVE_ROUNDS = 200;
+// 测量批量阈值时场景中已有的项数，以及每个批量大小的重复次数
+const int BULK_BASE_ITEMS = 1000;
+const int BULK_ROUNDS = 20;
+
+struct IndexCase {
+    const char *name;
+    SceneIndexConfig config;
+    bool bulkLoad; // 加入项时使用 SceneBulkLoadGuard
+};
+
+struct IndexTimings {
+    qreal insertMs = 0;
+    qreal selectionMs = 0;   // 每次框选
+    qreal hitTestUs = 0;     // 每次命中测试
+    qreal selectedItemsUs = 0;
+    qreal moveUs = 0;        // 每次移动一个项
+};
+
+static qreal elapsedMs(const QElapsedTimer &timer)
+{
+    return timer.nsecsElapsed() / 1e6;
+}
+
+// 随机散布的截图大小的项，平均每个项周围留有与自身相当的空白，模拟拼贴草稿
+static IndexTimings runCase(const IndexCase &indexCase, int itemCount)
+{
+    IndexTimings timings;
+    QRandomGenerator random(42);
+    const qreal side = qSqrt(qreal(itemCount)) * 400;
+
+    QImage image(200, 150, QImage::Format_RGB32);
+    image.fill(Qt::darkCyan);
+    const QPixmap pixmap = QPixmap::fromImage(image);
+
+    QGraphicsScene scene;
+    applySceneIndexConfig(&scene, indexCase.config);
+    scene.setSceneRect(0, 0, side, side);
+
+    QList<ResizablePixmapItem*> items;
+    QElapsedTimer timer;
+    timer.start();
+    {
+        QScopedPointer<SceneBulkLoadGuard> guard(indexCase.bulkLoad ? new SceneBulkLoadGuard(&scene) : nullptr);
+        for (int i = 0; i < itemCount; ++i) {
+            ResizablePixmapItem *item = new ResizablePixmapItem(pixmap);
+            item->setPos(random.bounded(side), random.bounded(side));
+            scene.addItem(item);
+            items.append(item);
+        }
+    }
+    // 第一次查询时 BSP 树才真正建立，计入加入的开销
+    scene.items(QPointF(0, 0));
+    timings.insertMs = elapsedMs(timer);
+
+    // 框选：与 RubberBandDrag 相同的 setSelectionArea 路径，每次约占场景面积的 1%
+    timer.restart();
+    for (int i = 0; i < SELECTION_ROUNDS; ++i) {
+        QPainterPath path;
+        path.addRect(random.bounded(side), random.bounded(side), side / 10, side / 10);
+        scene.setSelectionArea(path);
+    }
+    timings.selectionMs = elapsedMs(timer) / SELECTION_ROUNDS;
+
+    // 命中测试：鼠标位置下的项
+    timer.restart();
+    for (int i = 0; i < HIT_TEST_ROUNDS; ++i) {
+        scene.items(QPointF(random.bounded(side), random.bounded(side)));
+    }
+    timings.hitTestUs = elapsedMs(timer) * 1000 / HIT_TEST_ROUNDS;
+
+    // 选中约一半的项后读取 selectedItems()
+    QPainterPath half;
+    half.addRect(0, 0, side, side / 2);
+    scene.setSelectionArea(half);
+    timer.restart();
+    for (int i = 0; i < SELECTED_ITEMS_ROUNDS; ++i) {
+        scene.selectedItems();
+    }
+    timings.selectedItemsUs = elapsedMs(timer) * 1000 / SELECTED_ITEMS_ROUNDS;
+
+    // 移动项并查询，索引需要随之更新
+    timer.restart();
+    for (int i = 0; i < MOVE_ROUNDS; ++i) {
+        ResizablePixmapItem *item = items.at(random.bounded(items.size()));
+        item->setPos(random.bounded(side), random.bounded(side));
+        scene.items(item->pos());
+    }
+    timings.moveUs = elapsedMs(timer) * 1000 / MOVE_ROUNDS;
+
+    return timings;
+}
+
+// 向已有 BULK_BASE_ITEMS 个项的场景中一次加入 batchSize 个项再移除（与拖入多张图片和撤销相同），
+// 每次之后做一次查询让索引真正更新；返回每轮的平均毫秒数
+static qreal runBulkCase(const SceneIndexConfig &config, int batchSize, bool bulkLoad)
+{
+    QRandomGenerator random(7);
+    const qreal side = qSqrt(qreal(BULK_BASE_ITEMS)) * 400;
+
+    QImage image(200, 150, QImage::Format_RGB32);
+    image.fill(Qt::darkCyan);
+    const QPixmap pixmap = QPixmap::fromImage(image);
+
+    QGraphicsScene scene;
+    applySceneIndexConfig(&scene, config);
+    scene.setSceneRect(0, 0, side, side);
+    for (int i = 0; i < BULK_BASE_ITEMS; ++i) {
+        ResizablePixmapItem *item = new ResizablePixmapItem(pixmap);
+        item->setPos(random.bounded(side), random.bounded(side));
+        scene.addItem(item);
+    }
+    scene.items(QPointF(0, 0));
+
+    QList<ResizablePixmapItem*> batch;
+    for (int i = 0; i < batchSize; ++i) {
+        batch.append(new ResizablePixmapItem(pixmap));
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+    for (int round = 0; round < BULK_ROUNDS; ++round) {
+        {
+            QScopedPointer<SceneBulkLoadGuard> guard(bulkLoad ? new SceneBulkLoadGuard(&scene) : nullptr);
+            for (ResizablePixmapItem *item : std::as_const(batch)) {
+                item->setPos(random.bounded(side), random.bounded(side));
+                scene.addItem(item);
+            }
+        }
+        scene.items(QPointF(random.bounded(side), random.bounded(side)));
+        {
+            QScopedPointer<SceneBulkLoadGuard> guard(bulkLoad ? new SceneBulkLoadGuard(&scene) : nullptr);
+            for (ResizablePixmapItem *item : std::as_const(batch)) {
+                scene.removeItem(item);
+            }
+        }
+        scene.items(QPointF(random.bounded(side), random.bounded(side)));
+    }
+    const qreal ms = elapsedMs(timer) / BULK_ROUNDS;
+    qDeleteAll(batch);
+    return ms;
+}
+
+bool isIndexBenchmarkRequested(int argc, char *argv[])
+{
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], kIndexBenchmarkFlag) == 0)
+            return true;
+    }
+    return false;
+}
+
+int runIndexBenchmark(const QStringList &arguments)
+{
+    SceneIndexConfig bspAuto;
+    SceneIndexConfig bspShallow;
+    bspShallow.bspTreeDepth = 6;
+    SceneIndexConfig bspDeep;
+    bspDeep.bspTreeDepth = 12;
+    SceneIndexConfig noIndex;
+    noIndex.useBspTree = false;
+
+    const QList<IndexCase> cases = {
+        {"bsp-auto", bspAuto, false},
+        {"bsp-auto+bulk", bspAuto, true},
+        {"bsp-6", bspShallow, false},
+        {"bsp-12", bspDeep, false},
+        {"none", noIndex, false},
+    };
+    const QList<int> counts = {100, 1000, 10000};
+
+    QTextStream err(stderr);
+    err << QString("%1 %2 %3 %4 %5 %6 %7\n")
+               .arg("items", -7).arg("index", -15).arg("insert(ms)", 11).arg("select(ms)", 11)
+               .arg("hit(us)", 9).arg("selected(us)", 13).arg("move(us)", 9);
+
+    // 各方案在所有项数下的得分之和，决定推荐的索引方式；批量加入另行测量
+    QVector<qreal> totalScores(cases.size(), 0);
+    for (int count : counts) {
+        QString best;
+        qreal bestScore = 0;
+        for (int i = 0; i < cases.size(); ++i) {
+            const IndexCase &indexCase = cases.at(i);
+            const IndexTimings t = runCase(indexCase, count);
+            err << QString("%1 %2 %3 %4 %5 %6 %7\n")
+                       .arg(count, -7).arg(QLatin1String(indexCase.name), -15)
+                       .arg(t.insertMs, 11, 'f', 2).arg(t.selectionMs, 11, 'f', 3)
+                       .arg(t.hitTestUs, 9, 'f', 2).arg(t.selectedItemsUs, 13, 'f', 2)
+                       .arg(t.moveUs, 9, 'f', 2);
+            err.flush();
+
+            // 交互操作按一次拖动约 60 帧折算，加入只发生一次
+            const qreal score = t.insertMs + 60 * (t.selectionMs + (t.hitTestUs + t.selectedItemsUs + t.moveUs) / 1000);
+            if (best.isEmpty() || score < bestScore) {
+                best = QLatin1String(indexCase.name);
+                bestScore = score;
+            }
+            totalScores[i] += score;
+        }
+        err << QString("  -> %1 items: fastest overall is %2\n").arg(count).arg(best);
+    }
+
+    int bestCase = -1;
+    for (int i = 0; i < cases.size(); ++i) {
+        if (cases.at(i).bulkLoad)
+            continue;
+        if (bestCase < 0 || totalScores.at(i) < totalScores.at(bestCase))
+            bestCase = i;
+    }
+    SceneIndexConfig recommended = cases.at(bestCase).config;
+
+    // 批量阈值：加入的项数从小到大，取 SceneBulkLoadGuard 第一次比逐个加入快的批量大小
+    err << QString("\n%1 %2 %3\n").arg("batch", -7).arg("plain(ms)", 11).arg("bulk(ms)", 11);
+    const QList<int> batchSizes = {2, 4, 8, 16, 32, 64, 128};
+    recommended.bulkLoadThreshold = 0;
+    for (int batchSize : batchSizes) {
+        const qreal plainMs = runBulkCase(recommended, batchSize, false);
+        const qreal bulkMs = runBulkCase(recommended, batchSize, true);
+        err << QString("%1 %2 %3\n").arg(batchSize, -7).arg(plainMs, 11, 'f', 3).arg(bulkMs, 11, 'f', 3);
+        err.flush();
+        if (recommended.bulkLoadThreshold == 0 && bulkMs < plainMs)
+            recommended.bulkLoadThreshold = batchSize;
+    }
+    // 测到的批量大小内都不划算时，只在更大的批量（例如打开草稿）时使用
+    if (recommended.bulkLoadThreshold == 0)
+        recommended.bulkLoadThreshold = batchSizes.last() * 2;
+
+    err << QString("\nrecommended: index %1, bulk load from %2 items\n")
+               .arg(QLatin1String(cases.at(bestCase).name))
+               .arg(recommended.bulkLoadThreshold);
+    if (arguments.contains(QLatin1String(kSaveFlag))) {
+        recommended.save();
+        err << "saved to settings\n";
+    } else {
+        err << "run with --save to store it in the settings\n";
+    }
+    return 0;
+}
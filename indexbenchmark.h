@@ -0,0 +1,13 @@
+#ifndef INDEXBENCHMARK_H
+#define INDEXBENCHMARK_H
+
+#include <QStringList>
+
+// 场景索引基准测试：在 100 / 1000 / 10000 个项的场景上比较不同索引方案的
+// 批量加入、框选、命中测试、selectedItems() 和移动项的耗时，再测量一次加入多少个项时
+// SceneBulkLoadGuard 开始划算，最后给出推荐的 SceneIndexConfig。
+// 用法：ez-paster --benchmark-index [--save]，--save 把推荐配置写入设置
+bool isIndexBenchmarkRequested(int argc, char *argv[]);
+int runIndexBenchmark(const QStringList &arguments);
+
+#endif // INDEXBENCHMARK_H
@@ -1,9 +1,23 @@
 #include "mainwindow.h"
+#include "exportbenchmark.h"
+#include "indexbenchmark.h"
+#include "headlessexport.h"
 
 #include <QApplication>
+#include <QElapsedTimer>
 
 int main(int argc, char *argv[])
 {
+    QElapsedTimer startupTimer;
+    startupTimer.start();
+
+    // 基准测试和批量导出不需要显示窗口，在创建 QApplication 之前切换到 offscreen 平台
+    const bool benchmark = isExportBenchmarkRequested(argc, argv);
+    const bool indexBenchmark = isIndexBenchmarkRequested(argc, argv);
+    const bool headless = isHeadlessExportRequested(argc, argv);
+    if ((benchmark || indexBenchmark || headless) && qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM"))
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+
     QApplication a(argc, argv);
 
     // Optional: Set Application Info for better integration
@@ -11,6 +25,13 @@ int main(int argc, char *argv[])
     QCoreApplication::setApplicationName("EZ Paster");
     QCoreApplication::setApplicationVersion(QT_VERSION_STR);
 
+    if (benchmark)
+        return runExportBenchmark(a.arguments());
+    if (indexBenchmark)
+        return runIndexBenchmark(a.arguments());
+    if (headless)
+        return runHeadlessExport(a.arguments(), startupTimer.elapsed());
+
     MainWindow w;
     w.show();
     return a.exec();
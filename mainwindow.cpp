@@ -1,5 +1,16 @@
 #include "mainwindow.h"
 #include "draftwidget.h"
+#include "draftexporter.h"
+#include "exportjob.h"
+#include "scenesnapshot.h"
+#include "draftdocument.h"
+#include "pixmapstore.h"
+#include "imagesource.h"
+#include "resizablepixmapitem.h"
+#include "memoryusage.h"
+#include "renderqualitycontroller.h"
+#include "undostack.h"
+#include "desktopcapture.h"
 
 #include <QApplication>
 #include <QMenuBar>
@@ -9,6 +20,7 @@
 #include <QIcon>
 #include <QMessageBox>
 #include <QFileDialog>
+#include <QFileInfo>
 #include <QPixmap>
 #include <QImageWriter>
 #include <QPainter>
@@ -23,9 +35,17 @@
 #include <QSlider>
 #include <QLabel>
 #include <QStatusBar>
+#include <QProgressBar>
+#include <QPushButton>
 #include <QMouseEvent>
 #include <QKeyEvent>
+#include <QPaintEvent>
 #include <QEvent>
+#include <QDebug>
+#include <QWindow>
+#include <QtMath>
+
+#include <algorithm>
 
 #if QT_VERSION >= QT_VERSION_CHECK(6, 0, 0)
 #include <QScreen>
@@ -33,22 +53,54 @@
 #include <QDesktopWidget>
 #endif
 
+// 检查标签页休眠的间隔
+const int HIBERNATE_CHECK_INTERVAL_MS = 60 * 1000;
+// 刷新内存统计的间隔
+const int MEMORY_UPDATE_INTERVAL_MS = 2000;
+// 截图前等待主窗口隐藏的最长时间（原先固定等待的时长）
+const int SCREENSHOT_HIDE_TIMEOUT_MS = 200;
+
 MainWindow::MainWindow(QWidget *parent)
     : QMainWindow(parent),
       zoomFactor(1.0),
+      smoothZoom(true),
+      adaptiveRenderQuality(true),
+      renderQualityIdleMs(250),
+      tileCacheRendering(false),
+      undoMemoryMB(256),
+      screenshotToClipboard(true),
+      prewarmScreenshotOverlay(true),
+      m_exportJob(nullptr),
+      exportPadding(0),
+      hibernateTimer(nullptr),
+      memoryTimer(nullptr),
+      hibernateAfterMinutes(10),
+      memoryBudgetMB(1024),
+      m_waitingForHide(false),
+      m_hideFallbackTimer(nullptr),
       m_selectionWidget(nullptr), // 初始化截图成员
       m_rubberBand(nullptr),
-      m_isSelecting(false)
+      m_isSelecting(false),
+      m_overlayWasCold(false),
+      m_overlayPainted(true)
 {
     loadSettings();
     setupUI();
     setupConnections();
     setupZoomControls();
+    setupExportControls();
+    updateMemoryUsage();
+
+    // 启动完成后在空闲时预先创建截图选区窗口
+    if (prewarmScreenshotOverlay)
+        QTimer::singleShot(0, this, &MainWindow::ensureSelectionOverlay);
 }
 
 MainWindow::~MainWindow()
 {
     saveSettings();
+    // 选区窗口是没有父对象的顶层窗口
+    delete m_selectionWidget;
 }
 
 void MainWindow::closeEvent(QCloseEvent *event)
@@ -71,11 +123,28 @@ void MainWindow::setupUI()
     newAction->setShortcuts(QKeySequence::New);
     newAction->setStatusTip(tr("创建一个新的草稿纸"));
 
+    openAction = new QAction(QIcon::fromTheme("document-open"), tr("打开草稿..."), this);
+    openAction->setShortcuts(QKeySequence::Open);
+    openAction->setStatusTip(tr("打开保存过的草稿文件"));
+
+    saveAction = new QAction(QIcon::fromTheme("document-save"), tr("保存草稿..."), this);
+    saveAction->setShortcuts(QKeySequence::Save);
+    saveAction->setStatusTip(tr("将当前草稿保存为文件"));
+    saveAction->setEnabled(false);
+
     exportAction = new QAction(QIcon::fromTheme("document-save-as"), tr("导出为JPG..."), this);
     exportAction->setShortcuts(QKeySequence::SaveAs);
     exportAction->setStatusTip(tr("将当前草稿导出为JPG图像"));
     exportAction->setEnabled(false);
 
+    exportSelectionAction = new QAction(tr("导出选中内容..."), this);
+    exportSelectionAction->setStatusTip(tr("只导出选中的图片"));
+    exportSelectionAction->setEnabled(false);
+
+    exportViewportAction = new QAction(tr("导出当前视图..."), this);
+    exportViewportAction->setStatusTip(tr("导出当前窗口中可见的区域"));
+    exportViewportAction->setEnabled(false);
+
     quitAction = new QAction(QIcon::fromTheme("application-exit"), tr("退出"), this);
     quitAction->setShortcuts(QKeySequence::Quit);
     quitAction->setStatusTip(tr("退出应用程序"));
@@ -84,6 +153,11 @@ void MainWindow::setupUI()
     screenshotAction->setShortcut(QKeySequence("F11"));
     screenshotAction->setStatusTip(tr("截取屏幕并粘贴到当前草稿"));
 
+    screenshotClipboardAction = new QAction(tr("截图同时复制到剪贴板"), this);
+    screenshotClipboardAction->setCheckable(true);
+    screenshotClipboardAction->setChecked(screenshotToClipboard);
+    screenshotClipboardAction->setStatusTip(tr("截图放到草稿后再复制一份到系统剪贴板"));
+
     // 缩放操作
     zoomInAction = new QAction(QIcon::fromTheme("zoom-in"), tr("放大"), this);
     zoomInAction->setStatusTip(tr("放大视图"));
@@ -94,20 +168,68 @@ void MainWindow::setupUI()
     resetZoomAction = new QAction(QIcon::fromTheme("zoom-original"), tr("重置缩放"), this);
     resetZoomAction->setStatusTip(tr("重置缩放到100%"));
 
+    adaptiveQualityAction = new QAction(tr("交互时快速绘制"), this);
+    adaptiveQualityAction->setCheckable(true);
+    adaptiveQualityAction->setChecked(adaptiveRenderQuality);
+    adaptiveQualityAction->setStatusTip(tr("拖动和缩放当前草稿时降低绘制质量，停止后恢复平滑绘制"));
+
+    tileCacheAction = new QAction(tr("图块缓存绘制"), this);
+    tileCacheAction->setCheckable(true);
+    tileCacheAction->setChecked(tileCacheRendering);
+    tileCacheAction->setStatusTip(tr("在后台预先渲染当前草稿视口周围的内容，加快平移和缩放"));
+
+    // 编辑操作
+    undoAction = new QAction(QIcon::fromTheme("edit-undo"), tr("撤销"), this);
+    undoAction->setShortcuts(QKeySequence::Undo);
+    undoAction->setEnabled(false);
+
+    redoAction = new QAction(QIcon::fromTheme("edit-redo"), tr("重做"), this);
+    redoAction->setShortcuts(QKeySequence::Redo);
+    redoAction->setEnabled(false);
+
+    bringToFrontAction = new QAction(tr("置于顶层"), this);
+    bringToFrontAction->setShortcut(QKeySequence("Ctrl+Shift+]"));
+    bringToFrontAction->setStatusTip(tr("把选中的图片移到所有图片之上"));
+
+    sendToBackAction = new QAction(tr("置于底层"), this);
+    sendToBackAction->setShortcut(QKeySequence("Ctrl+Shift+["));
+    sendToBackAction->setStatusTip(tr("把选中的图片移到所有图片之下"));
+
+    flattenAction = new QAction(tr("合并选中项"), this);
+    flattenAction->setShortcut(QKeySequence("Ctrl+Shift+M"));
+    flattenAction->setStatusTip(tr("把选中的图片按当前位置和大小合并为一张图片"));
+
     // Menu Bar
     QMenu *fileMenu = menuBar()->addMenu(tr("文件"));
     fileMenu->addAction(newAction);
+    fileMenu->addAction(openAction);
+    fileMenu->addAction(saveAction);
+    fileMenu->addSeparator();
     fileMenu->addAction(exportAction);
+    fileMenu->addAction(exportSelectionAction);
+    fileMenu->addAction(exportViewportAction);
     fileMenu->addSeparator();
     fileMenu->addAction(quitAction);
 
+    QMenu *editMenu = menuBar()->addMenu(tr("编辑"));
+    editMenu->addAction(undoAction);
+    editMenu->addAction(redoAction);
+    editMenu->addSeparator();
+    editMenu->addAction(bringToFrontAction);
+    editMenu->addAction(sendToBackAction);
+    editMenu->addAction(flattenAction);
+
     QMenu *toolsMenu = menuBar()->addMenu(tr("工具"));
     toolsMenu->addAction(screenshotAction);
+    toolsMenu->addAction(screenshotClipboardAction);
     
     QMenu *viewMenu = menuBar()->addMenu(tr("视图"));
     viewMenu->addAction(zoomInAction);
     viewMenu->addAction(zoomOutAction);
     viewMenu->addAction(resetZoomAction);
+    viewMenu->addSeparator();
+    viewMenu->addAction(adaptiveQualityAction);
+    viewMenu->addAction(tileCacheAction);
 
     // Toolbar
     QToolBar *fileToolBar = addToolBar(tr("文件"));
@@ -135,17 +257,51 @@ void MainWindow::setupUI()
 void MainWindow::setupConnections()
 {
     connect(newAction, &QAction::triggered, this, &MainWindow::createNewDraft);
+    connect(openAction, &QAction::triggered, this, &MainWindow::openDraft);
+    connect(saveAction, &QAction::triggered, this, &MainWindow::saveDraft);
     connect(exportAction, &QAction::triggered, this, &MainWindow::exportCurrentDraft);
+    connect(exportSelectionAction, &QAction::triggered, this, &MainWindow::exportSelection);
+    connect(exportViewportAction, &QAction::triggered, this, &MainWindow::exportViewport);
     connect(quitAction, &QAction::triggered, this, &MainWindow::close);
     connect(screenshotAction, &QAction::triggered, this, &MainWindow::captureScreenshot);
+    connect(screenshotClipboardAction, &QAction::toggled, this, [this](bool checked) {
+        screenshotToClipboard = checked;
+    });
     
     connect(tabWidget, &QTabWidget::tabCloseRequested, this, &MainWindow::closeDraftTab);
     connect(tabWidget, &QTabWidget::currentChanged, this, &MainWindow::updateActions);
+    connect(tabWidget, &QTabWidget::currentChanged, this, &MainWindow::onCurrentTabChanged);
+    m_activeDraft = qobject_cast<DraftWidget*>(tabWidget->currentWidget());
+
+    // 定期检查需要休眠的标签页
+    hibernateTimer = new QTimer(this);
+    hibernateTimer->setInterval(HIBERNATE_CHECK_INTERVAL_MS);
+    connect(hibernateTimer, &QTimer::timeout, this, &MainWindow::hibernateIdleTabs);
+    hibernateTimer->start();
+
+    // 定期刷新内存统计并执行内存预算
+    memoryTimer = new QTimer(this);
+    memoryTimer->setInterval(MEMORY_UPDATE_INTERVAL_MS);
+    connect(memoryTimer, &QTimer::timeout, this, &MainWindow::updateMemoryUsage);
+    memoryTimer->start();
+
+    // 截图时主窗口迟迟没有报告隐藏，超时后直接开始
+    m_hideFallbackTimer = new QTimer(this);
+    m_hideFallbackTimer->setSingleShot(true);
+    m_hideFallbackTimer->setInterval(SCREENSHOT_HIDE_TIMEOUT_MS);
+    connect(m_hideFallbackTimer, &QTimer::timeout, this, &MainWindow::onMainWindowHidden);
     
     // 连接缩放操作
     connect(zoomInAction, &QAction::triggered, this, &MainWindow::zoomIn);
     connect(zoomOutAction, &QAction::triggered, this, &MainWindow::zoomOut);
     connect(resetZoomAction, &QAction::triggered, this, &MainWindow::resetZoom);
+    connect(adaptiveQualityAction, &QAction::toggled, this, &MainWindow::setAdaptiveRenderQuality);
+    connect(tileCacheAction, &QAction::toggled, this, &MainWindow::setTileCacheRendering);
+    connect(undoAction, &QAction::triggered, this, &MainWindow::undo);
+    connect(redoAction, &QAction::triggered, this, &MainWindow::redo);
+    connect(flattenAction, &QAction::triggered, this, &MainWindow::flattenSelection);
+    connect(bringToFrontAction, &QAction::triggered, this, &MainWindow::bringToFront);
+    connect(sendToBackAction, &QAction::triggered, this, &MainWindow::sendToBack);
 }
 
 void MainWindow::setupZoomControls()
@@ -161,7 +317,11 @@ void MainWindow::setupZoomControls()
     // 创建缩放标签
     zoomLabel = new QLabel(tr("缩放: 100%"));
     
+    // 内存统计：当前草稿 / 所有草稿 / 整个进程，悬停显示各标签页明细
+    memoryLabel = new QLabel;
+
     // 将它们添加到状态栏
+    statusBar()->addPermanentWidget(memoryLabel);
     statusBar()->addPermanentWidget(zoomLabel);
     statusBar()->addPermanentWidget(zoomSlider);
     
@@ -169,6 +329,24 @@ void MainWindow::setupZoomControls()
     connect(zoomSlider, &QSlider::valueChanged, this, &MainWindow::updateZoomLevel);
 }
 
+void MainWindow::setupExportControls()
+{
+    // 导出进度条和取消按钮，仅在后台导出时显示
+    exportProgressBar = new QProgressBar;
+    exportProgressBar->setRange(0, 100);
+    exportProgressBar->setMaximumWidth(150);
+    exportProgressBar->setVisible(false);
+
+    exportCancelButton = new QPushButton(tr("取消导出"));
+    exportCancelButton->setVisible(false);
+
+    // 放在缩放控件左侧
+    statusBar()->insertPermanentWidget(0, exportCancelButton);
+    statusBar()->insertPermanentWidget(0, exportProgressBar);
+
+    connect(exportCancelButton, &QPushButton::clicked, this, &MainWindow::cancelExport);
+}
+
 void MainWindow::zoomIn()
 {
     applyZoom(zoomFactor * 1.2);
@@ -194,6 +372,7 @@ void MainWindow::updateZoomLevel(int value)
         factor = 1.0 / (1.0 - value * 0.1); // 100% - 10%
     }
     
+    // 拖动滑块产生的连续请求与滚轮一样按帧合并
     applyZoom(factor);
 }
 
@@ -205,38 +384,197 @@ void MainWindow::applyZoom(qreal factor)
     
     zoomFactor = factor;
     
-    // 更新当前草稿的缩放
+    // 更新当前草稿的缩放，实际变换在下一帧由草稿应用并通过 zoomChanged 同步界面
     DraftWidget *currentDraft = qobject_cast<DraftWidget*>(tabWidget->currentWidget());
     if (currentDraft) {
-        currentDraft->setZoomFactor(zoomFactor);
+        currentDraft->requestZoom(zoomFactor);
+    } else {
+        syncZoomControls(zoomFactor);
     }
-    
+}
+
+void MainWindow::onDraftZoomChanged(qreal factor)
+{
+    DraftWidget *draft = qobject_cast<DraftWidget*>(sender());
+    if (!draft || draft != tabWidget->currentWidget())
+        return;
+
+    // 滚轮缩放也会改变目标值，按钮和滑块以目标值为基准继续缩放
+    zoomFactor = draft->targetZoomFactor();
+    syncZoomControls(factor);
+}
+
+void MainWindow::syncZoomControls(qreal factor)
+{
     // 更新滑块位置
     int sliderValue;
-    if (zoomFactor >= 1.0) {
-        sliderValue = qRound((zoomFactor - 1.0) * 10);
+    if (factor >= 1.0) {
+        sliderValue = qRound((factor - 1.0) * 10);
     } else {
-        sliderValue = -qRound((1.0 / zoomFactor - 1.0) * 10);
+        sliderValue = -qRound((1.0 / factor - 1.0) * 10);
     }
     
-    // 更新UI，阻断信号避免递归
-    zoomSlider->blockSignals(true);
-    zoomSlider->setValue(sliderValue);
-    zoomSlider->blockSignals(false);
+    // 更新UI，阻断信号避免递归；用户正在拖动滑块时不要把它拉回动画中间值
+    if (!zoomSlider->isSliderDown()) {
+        zoomSlider->blockSignals(true);
+        zoomSlider->setValue(sliderValue);
+        zoomSlider->blockSignals(false);
+    }
     
     // 更新标签
-    zoomLabel->setText(tr("缩放: %1%").arg(qRound(zoomFactor * 100)));
+    zoomLabel->setText(tr("缩放: %1%").arg(qRound(factor * 100)));
+}
+
+void MainWindow::setAdaptiveRenderQuality(bool enabled)
+{
+    // 只作用于当前草稿，同时作为新草稿的默认值
+    adaptiveRenderQuality = enabled;
+    DraftWidget *currentDraft = qobject_cast<DraftWidget*>(tabWidget->currentWidget());
+    if (currentDraft)
+        currentDraft->renderQuality()->setEnabled(enabled);
+}
+
+void MainWindow::setTileCacheRendering(bool enabled)
+{
+    // 只作用于当前草稿，同时作为新草稿的默认值
+    tileCacheRendering = enabled;
+    DraftWidget *currentDraft = qobject_cast<DraftWidget*>(tabWidget->currentWidget());
+    if (currentDraft)
+        currentDraft->setTileCacheEnabled(enabled);
+}
+
+void MainWindow::initDraft(DraftWidget *draft)
+{
+    draft->setZoomFactor(zoomFactor); // 应用当前主窗口的缩放级别到新草稿
+    draft->setSmoothZoom(smoothZoom);
+    draft->renderQuality()->setEnabled(adaptiveRenderQuality);
+    draft->renderQuality()->setIdleInterval(renderQualityIdleMs);
+    draft->setTileCacheEnabled(tileCacheRendering);
+    applySceneIndexConfig(draft->scene(), sceneIndexConfig);
+    draft->setBulkLoadThreshold(sceneIndexConfig.bulkLoadThreshold);
+    draft->undoStack()->setMemoryLimit(qint64(undoMemoryMB) * 1024 * 1024);
+    connect(draft, &DraftWidget::zoomChanged, this, &MainWindow::onDraftZoomChanged);
+    connect(draft, &DraftWidget::flattenFinished, this, [this](const QString &message) {
+        statusBar()->showMessage(message, 5000);
+    });
+    connect(draft->undoStack(), &UndoStack::changed, this, &MainWindow::updateUndoActions);
+    connect(draft->undoStack(), &UndoStack::memoryLimitExceeded, this, [this](const QString &text) {
+        statusBar()->showMessage(tr("“%1”占用的内存超过了撤销历史上限，下一次操作时将从历史中移除").arg(text), 5000);
+    });
+}
+
+void MainWindow::undo()
+{
+    DraftWidget *currentDraft = qobject_cast<DraftWidget*>(tabWidget->currentWidget());
+    if (currentDraft)
+        currentDraft->undoStack()->undo();
+}
+
+void MainWindow::redo()
+{
+    DraftWidget *currentDraft = qobject_cast<DraftWidget*>(tabWidget->currentWidget());
+    if (currentDraft)
+        currentDraft->undoStack()->redo();
+}
+
+void MainWindow::flattenSelection()
+{
+    DraftWidget *currentDraft = qobject_cast<DraftWidget*>(tabWidget->currentWidget());
+    if (!currentDraft)
+        return;
+
+    // 在后台渲染，结果通过 flattenFinished 显示在状态栏
+    statusBar()->showMessage(tr("正在合并选中项..."));
+    currentDraft->flattenSelection();
+}
+
+void MainWindow::bringToFront()
+{
+    DraftWidget *currentDraft = qobject_cast<DraftWidget*>(tabWidget->currentWidget());
+    if (currentDraft)
+        currentDraft->bringSelectionToFront();
+}
+
+void MainWindow::sendToBack()
+{
+    DraftWidget *currentDraft = qobject_cast<DraftWidget*>(tabWidget->currentWidget());
+    if (currentDraft)
+        currentDraft->sendSelectionToBack();
+}
+
+void MainWindow::updateUndoActions()
+{
+    DraftWidget *currentDraft = qobject_cast<DraftWidget*>(tabWidget->currentWidget());
+    UndoStack *stack = currentDraft ? currentDraft->undoStack() : nullptr;
+    undoAction->setEnabled(stack && stack->canUndo());
+    redoAction->setEnabled(stack && stack->canRedo());
+    undoAction->setText(stack && stack->canUndo() ? tr("撤销%1").arg(stack->undoText()) : tr("撤销"));
+    redoAction->setText(stack && stack->canRedo() ? tr("重做%1").arg(stack->redoText()) : tr("重做"));
 }
 
 void MainWindow::createNewDraft()
 {
     DraftWidget *draft = new DraftWidget(this);
-    draft->setZoomFactor(zoomFactor); // 应用当前主窗口的缩放级别到新草稿
+    initDraft(draft);
     int index = tabWidget->addTab(draft, tr("草稿 %1").arg(tabWidget->count() + 1));
     tabWidget->setCurrentIndex(index);
     updateActions();
 }
 
+void MainWindow::openDraft()
+{
+    const QString fileName = QFileDialog::getOpenFileName(this,
+                                                          tr("打开草稿"),
+                                                          "",
+                                                          tr("EZ Paster 草稿 (*.ezd);;所有文件 (*.*)"));
+    if (fileName.isEmpty())
+        return;
+
+    // 先应用索引配置，加载完成后只按最终配置重建一次索引
+    DraftWidget *draft = new DraftWidget(this);
+    initDraft(draft);
+    QString errorString;
+    if (!DraftDocument::load(draft->scene(), fileName, &errorString)) {
+        delete draft;
+        QMessageBox::warning(this, tr("打开失败"), tr("无法打开草稿 %1。\n%2").arg(fileName, errorString));
+        return;
+    }
+
+    draft->setFilePath(fileName);
+    int index = tabWidget->addTab(draft, QFileInfo(fileName).completeBaseName());
+    tabWidget->setCurrentIndex(index);
+    updateActions();
+}
+
+void MainWindow::saveDraft()
+{
+    DraftWidget *currentDraft = qobject_cast<DraftWidget*>(tabWidget->currentWidget());
+    if (!currentDraft)
+        return;
+
+    QString fileName = currentDraft->filePath();
+    if (fileName.isEmpty()) {
+        fileName = QFileDialog::getSaveFileName(this,
+                                                tr("保存草稿"),
+                                                "",
+                                                tr("EZ Paster 草稿 (*.ezd)"));
+        if (fileName.isEmpty())
+            return;
+        if (QFileInfo(fileName).suffix().isEmpty())
+            fileName += ".ezd";
+    }
+
+    QString errorString;
+    if (!DraftDocument::save(currentDraft->scene(), fileName, &errorString)) {
+        QMessageBox::warning(this, tr("保存失败"), tr("无法保存草稿 %1。\n%2").arg(fileName, errorString));
+        return;
+    }
+
+    currentDraft->setFilePath(fileName);
+    tabWidget->setTabText(tabWidget->currentIndex(), QFileInfo(fileName).completeBaseName());
+    statusBar()->showMessage(tr("草稿已保存到 %1").arg(fileName), 5000);
+}
+
 void MainWindow::closeDraftTab(int index)
 {
     if (index >= 0 && index < tabWidget->count()) {
@@ -249,15 +587,39 @@ void MainWindow::closeDraftTab(int index)
 }
 
 void MainWindow::exportCurrentDraft()
+{
+    exportDraft(DraftWidget::ExportContent);
+}
+
+void MainWindow::exportSelection()
+{
+    exportDraft(DraftWidget::ExportSelection);
+}
+
+void MainWindow::exportViewport()
+{
+    exportDraft(DraftWidget::ExportViewport);
+}
+
+void MainWindow::exportDraft(DraftWidget::ExportRegion region)
 {
     DraftWidget *currentDraft = qobject_cast<DraftWidget*>(tabWidget->currentWidget());
-    if (!currentDraft)
+    if (!currentDraft || m_exportJob)
+        return;
+
+    // 只导出实际占用的区域，而不是只增不减的 sceneRect
+    const QRectF sourceRect = currentDraft->exportRect(region, exportPadding);
+    if (sourceRect.isEmpty()) {
+        QMessageBox::information(this, tr("导出"),
+                                 region == DraftWidget::ExportSelection ? tr("没有选中的图片。")
+                                                                        : tr("草稿中没有可导出的内容。"));
         return;
+    }
 
     QString fileName = QFileDialog::getSaveFileName(this,
                                                    tr("导出草稿"),
                                                    "",
-                                                   tr("JPEG图像 (*.jpg);;所有文件 (*.*)"));
+                                                   tr("JPEG图像 (*.jpg);;PNG图像 (*.png);;BMP图像 (*.bmp);;所有文件 (*.*)"));
 
     if (!fileName.isEmpty()) {
         QFileInfo fi(fileName);
@@ -265,100 +627,302 @@ void MainWindow::exportCurrentDraft()
             fileName += ".jpg";
         }
 
-        // Render the scene to a QPixmap
-        QPixmap pixmap(currentDraft->sceneRect().size().toSize());
-        pixmap.fill(Qt::white); // Set a background color for export
-        QPainter painter(&pixmap);
-        painter.setRenderHint(QPainter::Antialiasing);
-        currentDraft->scene()->render(&painter);
-        painter.end();
-
-        // Save the pixmap
-        if (!pixmap.save(fileName)) {
-            QMessageBox::warning(this, tr("导出失败"), tr("无法将图像保存到 %1。").arg(fileName));
-        }
+        // 在 GUI 线程中采集快照，渲染和编码都在后台进行，界面保持可交互
+        DraftExporter::Options options;
+        options.sourceRect = sourceRect;
+
+        const SceneSnapshot snapshot = SceneSnapshot::capture(currentDraft->scene(),
+                                                              region == DraftWidget::ExportSelection);
+        m_exportJob = new ExportJob(snapshot, fileName, options, this);
+        connect(m_exportJob, &ExportJob::progressChanged, this, [this](int percent, const QString &stage) {
+            exportProgressBar->setValue(percent);
+            statusBar()->showMessage(tr("导出中：%1 %2%").arg(stage).arg(percent));
+        });
+        connect(m_exportJob, &ExportJob::finished, this, &MainWindow::onExportFinished);
+
+        exportProgressBar->setValue(0);
+        exportProgressBar->setVisible(true);
+        exportCancelButton->setVisible(true);
+        updateActions();
+
+        m_exportJob->start();
+    }
+}
+
+void MainWindow::cancelExport()
+{
+    if (m_exportJob) {
+        m_exportJob->cancel();
+        statusBar()->showMessage(tr("正在取消导出..."));
+    }
+}
+
+void MainWindow::onExportFinished(bool success, bool cancelled, const QString &errorString)
+{
+    const QString fileName = m_exportJob->fileName();
+    m_exportJob->deleteLater();
+    m_exportJob = nullptr;
+
+    exportProgressBar->setVisible(false);
+    exportCancelButton->setVisible(false);
+    updateActions();
+
+    if (success) {
+        statusBar()->showMessage(tr("已导出到 %1").arg(fileName), 5000);
+    } else if (cancelled) {
+        statusBar()->showMessage(tr("导出已取消"), 5000);
+    } else {
+        statusBar()->clearMessage();
+        QMessageBox::warning(this, tr("导出失败"),
+                             tr("无法将图像保存到 %1。\n%2").arg(fileName, errorString));
+    }
+}
+
+void MainWindow::onCurrentTabChanged(int index)
+{
+    // 离开的标签页从此刻开始计算未查看时间
+    if (m_activeDraft)
+        m_activeDraft->markActive();
+
+    m_activeDraft = qobject_cast<DraftWidget*>(tabWidget->widget(index));
+    if (m_activeDraft) {
+        m_activeDraft->wake();
+        m_activeDraft->markActive();
+
+        adaptiveQualityAction->blockSignals(true);
+        adaptiveQualityAction->setChecked(m_activeDraft->renderQuality()->isEnabled());
+        adaptiveQualityAction->blockSignals(false);
+        tileCacheAction->blockSignals(true);
+        tileCacheAction->setChecked(m_activeDraft->tileCacheEnabled());
+        tileCacheAction->blockSignals(false);
+
+        // 各草稿可以用滚轮单独缩放，切换后让缩放控件显示该草稿的值
+        zoomFactor = m_activeDraft->targetZoomFactor();
+        syncZoomControls(m_activeDraft->zoomFactor());
+    }
+    updateUndoActions();
+}
+
+void MainWindow::hibernateIdleTabs()
+{
+    if (hibernateAfterMinutes <= 0)
+        return;
+
+    const qint64 idleLimitMs = qint64(hibernateAfterMinutes) * 60 * 1000;
+    for (DraftWidget *draft : draftsByLeastRecentlyViewed()) {
+        if (draft == tabWidget->currentWidget() || draft->isHibernating() || draft->inactiveMs() <= idleLimitMs)
+            continue;
+        draft->hibernate();
+    }
+}
+
+QList<DraftWidget*> MainWindow::draftsByLeastRecentlyViewed() const
+{
+    QList<DraftWidget*> drafts;
+    for (int i = 0; i < tabWidget->count(); ++i) {
+        if (DraftWidget *draft = qobject_cast<DraftWidget*>(tabWidget->widget(i)))
+            drafts.append(draft);
+    }
+    // 当前标签页永远排在最后，其余按未查看时间从长到短
+    QWidget *current = tabWidget->currentWidget();
+    std::sort(drafts.begin(), drafts.end(), [current](const DraftWidget *a, const DraftWidget *b) {
+        if ((a == current) != (b == current))
+            return b == current;
+        return a->inactiveMs() > b->inactiveMs();
+    });
+    return drafts;
+}
+
+void MainWindow::updateMemoryUsage()
+{
+    const QList<DraftWidget*> drafts = draftsByLeastRecentlyViewed();
+
+    // 共享的 PixmapStore 像素在每个项里都计算了一次，总数中扣除重复部分
+    qint64 totalBytes = -PixmapStore::instance().savedBytes();
+    QStringList perTab;
+    for (DraftWidget *draft : drafts) {
+        const qint64 bytes = draft->memoryBytes();
+        totalBytes += bytes;
+        perTab.append(tr("%1: %2%3").arg(tabWidget->tabText(tabWidget->indexOf(draft)),
+                                         formatBytes(bytes),
+                                         draft->isHibernating() ? tr("（已休眠）") : QString()));
     }
+    totalBytes = qMax<qint64>(0, totalBytes);
+    totalBytes += ImageSource::decodedCacheBytes();
+
+    // 整幅解码缓存只是为了少解码几次，超出预算时最先释放
+    const qint64 budgetBytes = qint64(memoryBudgetMB) * 1024 * 1024;
+    if (totalBytes > budgetBytes)
+        totalBytes -= ImageSource::releaseDecodedCache();
+
+    // 超出预算时先按最久未查看的顺序释放缓存和全分辨率大图，仍然不够再休眠后台标签页
+    for (DraftWidget *draft : drafts) {
+        if (totalBytes <= budgetBytes)
+            break;
+        totalBytes -= draft->trimMemory(totalBytes - budgetBytes);
+    }
+    for (DraftWidget *draft : drafts) {
+        if (totalBytes <= budgetBytes)
+            break;
+        if (draft == tabWidget->currentWidget() || draft->isHibernating())
+            continue;
+        totalBytes -= draft->hibernate();
+        statusBar()->showMessage(tr("内存超出预算，已休眠标签页 %1")
+                                 .arg(tabWidget->tabText(tabWidget->indexOf(draft))), 5000);
+    }
+
+    DraftWidget *currentDraft = qobject_cast<DraftWidget*>(tabWidget->currentWidget());
+    memoryLabel->setText(tr("内存: %1 / 草稿 %2 / 进程 %3")
+                         .arg(formatBytes(currentDraft ? currentDraft->memoryBytes() : 0),
+                              formatBytes(qMax<qint64>(0, totalBytes)),
+                              formatBytes(processResidentBytes())));
+    // 遮挡剔除的统计一并显示：被上方不透明截图遮住而省掉的绘制
+    const ResizablePixmapItem::OcclusionStats occlusion = ResizablePixmapItem::occlusionStats();
+    memoryLabel->setToolTip(tr("预算 %1 MB，共享像素节省 %2\n%3\n遮挡剔除：跳过 %4 次绘制，少绘制 %5 万像素")
+                            .arg(memoryBudgetMB)
+                            .arg(formatBytes(PixmapStore::instance().savedBytes()), perTab.join('\n'))
+                            .arg(occlusion.skippedPaints)
+                            .arg(occlusion.skippedPixels / 10000)
+                            + renderQualityTip(currentDraft));
+}
+
+QString MainWindow::renderQualityTip(DraftWidget *draft) const
+{
+    // 当前草稿交互中快速绘制与静止时高质量绘制的平均帧耗时
+    if (!draft)
+        return QString();
+    const RenderQualityController *quality = draft->renderQuality();
+    if (quality->interactiveFrameMs() <= 0 || quality->qualityFrameMs() <= 0)
+        return QString();
+    return tr("\n绘制耗时：交互中 %1 ms/帧，静止时 %2 ms/帧，快速绘制节省 %3 ms/帧")
+        .arg(quality->interactiveFrameMs(), 0, 'f', 1)
+        .arg(quality->qualityFrameMs(), 0, 'f', 1)
+        .arg(quality->qualityFrameMs() - quality->interactiveFrameMs(), 0, 'f', 1);
 }
 
 void MainWindow::updateActions()
 {
     // Enable/disable actions based on whether any tabs are open
     bool hasTabs = tabWidget->count() > 0;
-    exportAction->setEnabled(hasTabs);
+    saveAction->setEnabled(hasTabs);
+    exportAction->setEnabled(hasTabs && !m_exportJob);
+    exportSelectionAction->setEnabled(hasTabs && !m_exportJob);
+    exportViewportAction->setEnabled(hasTabs && !m_exportJob);
     screenshotAction->setEnabled(hasTabs);
+    flattenAction->setEnabled(hasTabs);
+    bringToFrontAction->setEnabled(hasTabs);
+    sendToBackAction->setEnabled(hasTabs);
+    updateUndoActions();
 }
 
 void MainWindow::captureScreenshot()
 {
     // 如果正在进行截图，则忽略
-    if (m_selectionWidget) {
+    if ((m_selectionWidget && m_selectionWidget->isVisible()) || m_waitingForHide) {
+        return;
+    }
+
+    m_screenshotTimer.start();
+    QWindow *window = windowHandle();
+    if (!isVisible() || !window || !window->isExposed()) {
+        // 主窗口已经不在屏幕上（例如最小化或从托盘触发），不需要等待
+        qDebug() << "截图：主窗口不可见，立即开始，比固定延迟节省" << SCREENSHOT_HIDE_TIMEOUT_MS << "ms";
+        startScreenshotSelection();
         return;
     }
 
-    // 隐藏主窗口以便拍摄屏幕
+    // 隐藏主窗口以便拍摄屏幕。窗口真正从屏幕上移除时会收到 isExposed() 为 false 的
+    // Expose 事件，此时再等一个显示帧让合成器重绘下层内容；超时后无论如何开始截图
+    m_waitingForHide = true;
+    window->installEventFilter(this);
+    m_hideFallbackTimer->start();
     this->hide();
-    // 稍作延迟确保窗口已隐藏
-    QTimer::singleShot(200, this, [this]() {
-        QScreen *screen = QGuiApplication::primaryScreen();
-        if (!screen) {
-            qWarning("无法获取主屏幕");
-            this->show();
-            return;
-        }
-        // 抓取全屏
-        m_fullScreenshot = screen->grabWindow(0);
-        if (m_fullScreenshot.isNull()) {
-             qWarning("抓取屏幕失败");
-             this->show();
-             return;
-        }
+}
+
+void MainWindow::onMainWindowHidden()
+{
+    if (!m_waitingForHide)
+        return;
+    m_waitingForHide = false;
+    m_hideFallbackTimer->stop();
+    if (windowHandle())
+        windowHandle()->removeEventFilter(this);
 
-        // 创建全屏半透明窗口用于选择区域
-        m_selectionWidget = new QWidget(nullptr, Qt::WindowStaysOnTopHint | Qt::FramelessWindowHint);
+    const qint64 waited = m_screenshotTimer.elapsed();
+    if (waited >= SCREENSHOT_HIDE_TIMEOUT_MS) {
+        qDebug() << "截图：等待窗口隐藏超时" << waited << "ms";
+    } else {
+        qDebug() << "截图：窗口隐藏用时" << waited << "ms，比固定延迟节省"
+                 << SCREENSHOT_HIDE_TIMEOUT_MS - waited << "ms";
+    }
+    startScreenshotSelection();
+}
+
+void MainWindow::startScreenshotSelection()
+{
+    // 抓取所有屏幕；变暗的背景只合成一次，之后每次重绘只复制需要更新的区域
+    m_desktopCapture = DesktopCapture::grab(QColor(0, 0, 0, 70));
+    if (m_desktopCapture.isNull()) {
+         qWarning("抓取屏幕失败");
+         this->show();
+         return;
+    }
+
+    // 选区窗口只创建一次，之后的截图直接复用
+    m_overlayWasCold = !m_selectionWidget;
+    ensureSelectionOverlay();
+    m_isSelecting = false; // 重置选择状态
+    m_rubberBand->hide();
+    m_rubberBand->setGeometry(QRect());
+
+    // 覆盖整个虚拟桌面。只有一个屏幕时保持全屏状态，窗口管理器才会把它放在
+    // 任务栏和面板之上；全屏状态只能覆盖一个屏幕，多屏时改用几何覆盖
+    m_selectionWidget->setGeometry(m_desktopCapture.geometry());
+    if (QGuiApplication::screens().size() == 1)
         m_selectionWidget->setWindowState(Qt::WindowFullScreen);
-        // 设置窗口透明度，让背景图片可见
-        m_selectionWidget->setAttribute(Qt::WA_TranslucentBackground);
-        m_selectionWidget->setCursor(Qt::CrossCursor); // 设置十字光标
-
-        // 创建橡皮筋选择框
-        m_rubberBand = new QRubberBand(QRubberBand::Rectangle, m_selectionWidget);
-        // 可以自定义橡皮筋样式
-        // QPalette pal;
-        // pal.setBrush(QPalette::Highlight, QBrush(Qt::red));
-        // m_rubberBand->setPalette(pal);
-        m_rubberBand->setStyleSheet("border: 2px solid red; background-color: rgba(255, 255, 255, 10);");
-
-
-        // 使用事件过滤器捕获鼠标事件
-        m_selectionWidget->installEventFilter(this);
-        m_isSelecting = false; // 重置选择状态
-
-        // 连接销毁信号以进行清理
-        connect(m_selectionWidget, &QWidget::destroyed, this, &MainWindow::cleanupScreenshot);
-
-        // 显示选择窗口
-        m_selectionWidget->show();
-        m_selectionWidget->activateWindow(); // 确保窗口获得焦点以接收键盘事件
-
-        // 在选择窗口上绘制半透明遮罩和背景（可选，另一种方法）
-        // QPainter painter(m_selectionWidget);
-        // QPixmap semiTransparentPixmap = m_fullScreenshot;
-        // QPainter p(&semiTransparentPixmap);
-        // p.fillRect(semiTransparentPixmap.rect(), QColor(0, 0, 0, 100)); // 半透明黑色
-        // p.end();
-        // painter.drawPixmap(0, 0, semiTransparentPixmap);
+    else
+        m_selectionWidget->setWindowState(Qt::WindowNoState);
+    m_overlayPainted = false;
+    m_selectionWidget->show();
+    m_selectionWidget->raise();
+    m_selectionWidget->activateWindow(); // 确保窗口获得焦点以接收键盘事件
+}
 
-    });
+void MainWindow::ensureSelectionOverlay()
+{
+    if (m_selectionWidget)
+        return;
+
+    // 全屏半透明窗口用于选择区域
+    m_selectionWidget = new QWidget(nullptr, Qt::WindowStaysOnTopHint | Qt::FramelessWindowHint);
+    // 设置窗口透明度，让背景图片可见
+    m_selectionWidget->setAttribute(Qt::WA_TranslucentBackground);
+    m_selectionWidget->setCursor(Qt::CrossCursor); // 设置十字光标
+
+    // 创建橡皮筋选择框
+    m_rubberBand = new QRubberBand(QRubberBand::Rectangle, m_selectionWidget);
+    // 可以自定义橡皮筋样式
+    // QPalette pal;
+    // pal.setBrush(QPalette::Highlight, QBrush(Qt::red));
+    // m_rubberBand->setPalette(pal);
+    m_rubberBand->setStyleSheet("border: 2px solid red; background-color: rgba(255, 255, 255, 10);");
+
+    // 使用事件过滤器捕获鼠标事件
+    m_selectionWidget->installEventFilter(this);
+
+    // 提前完成样式计算并创建原生窗口，第一次截图时只需要显示
+    m_selectionWidget->ensurePolished();
+    m_rubberBand->ensurePolished();
+    m_selectionWidget->winId();
 }
 
 void MainWindow::cleanupScreenshot()
 {
-    // 这个槽函数在 m_selectionWidget 被销毁时调用
-    // 确保 MainWindow 中的指针被清理
-    m_selectionWidget = nullptr;
-    m_rubberBand = nullptr; // rubberBand 是 selectionWidget 的子控件，会被自动删除
+    // 选区窗口保留下来供下次截图使用，只隐藏
+    if (m_selectionWidget)
+        m_selectionWidget->hide();
     m_isSelecting = false;
-    m_fullScreenshot = QPixmap(); // 清空截图缓存
+    m_desktopCapture = DesktopCapture(); // 清空截图缓存
 
     // 如果主窗口仍然隐藏，则显示它
     if (!this->isVisible()) {
@@ -371,33 +935,42 @@ void MainWindow::handleScreenshotResult(const QPixmap &pixmap)
 {
      if (pixmap.isNull()) return;
 
-     // 复制到剪贴板
-     QGuiApplication::clipboard()->setPixmap(pixmap);
-
-     // 粘贴到当前草稿
+     // 直接放到当前草稿，与截图共享像素，不经过剪贴板
      DraftWidget *currentDraft = qobject_cast<DraftWidget*>(tabWidget->currentWidget());
-     if (currentDraft) {
-         currentDraft->pasteImageFromClipboard();
-     } else if (tabWidget->count() == 0) {
+     if (!currentDraft && tabWidget->count() == 0) {
          // 如果没有标签，创建一个新的
          createNewDraft();
          currentDraft = qobject_cast<DraftWidget*>(tabWidget->currentWidget());
-         if (currentDraft) {
-             // 确保新草稿的缩放设置正确
-             currentDraft->setZoomFactor(zoomFactor);
-             currentDraft->pasteImageFromClipboard();
-         }
      }
+     if (currentDraft)
+         currentDraft->addPixmap(pixmap);
 
      // 如果主窗口仍然隐藏，则显示它
      if (!this->isVisible()) {
          this->show();
          this->activateWindow();
      }
+
+     // 复制到剪贴板（可选）不在关键路径上：等草稿显示出截图之后再发布
+     if (screenshotToClipboard) {
+         QTimer::singleShot(0, this, [pixmap]() {
+             QGuiApplication::clipboard()->setPixmap(pixmap);
+         });
+     }
 }
 
 bool MainWindow::eventFilter(QObject *watched, QEvent *event)
 {
+    // 主窗口隐藏后的 Expose 事件：窗口已不在屏幕上，再等一个显示帧后开始截图
+    if (m_waitingForHide && watched == windowHandle() && event->type() == QEvent::Expose
+        && !windowHandle()->isExposed()) {
+        windowHandle()->removeEventFilter(this);
+        QScreen *currentScreen = windowHandle()->screen();
+        const qreal refreshRate = currentScreen && currentScreen->refreshRate() > 0 ? currentScreen->refreshRate() : 60.0;
+        QTimer::singleShot(qCeil(1000.0 / refreshRate), this, &MainWindow::onMainWindowHidden);
+        return QMainWindow::eventFilter(watched, event);
+    }
+
     // 只处理我们关心的选择窗口的事件
     if (watched == m_selectionWidget) {
         switch (event->type()) {
@@ -405,6 +978,8 @@ bool MainWindow::eventFilter(QObject *watched, QEvent *event)
                 QMouseEvent *mouseEvent = static_cast<QMouseEvent*>(event);
                 if (mouseEvent->button() == Qt::LeftButton) {
                     m_selStartPos = mouseEvent->pos();
+                    // 上一次的选区恢复为变暗的背景
+                    m_selectionWidget->update(m_rubberBand->geometry());
                     m_rubberBand->setGeometry(QRect(m_selStartPos, QSize()));
                     m_rubberBand->show();
                     m_isSelecting = true;
@@ -416,7 +991,11 @@ bool MainWindow::eventFilter(QObject *watched, QEvent *event)
                 QMouseEvent *mouseEvent = static_cast<QMouseEvent*>(event);
                 if (m_isSelecting) {
                     m_selEndPos = mouseEvent->pos();
-                    m_rubberBand->setGeometry(QRect(m_selStartPos, m_selEndPos).normalized());
+                    // 只重绘新旧选区的并集：旧选区变暗，新选区显示原图
+                    const QRect oldRect = m_rubberBand->geometry();
+                    const QRect newRect = QRect(m_selStartPos, m_selEndPos).normalized();
+                    m_rubberBand->setGeometry(newRect);
+                    m_selectionWidget->update(oldRect.united(newRect));
                     return true; // 事件已处理
                 }
                 break;
@@ -431,15 +1010,14 @@ bool MainWindow::eventFilter(QObject *watched, QEvent *event)
                     // 检查选区大小，避免误操作
                     if (selectedRect.width() > 4 && selectedRect.height() > 4) {
                         // 截取选定区域
-                        QPixmap selectedPixmap = m_fullScreenshot.copy(selectedRect);
+                        // 只合成选区经过的屏幕
+                        QPixmap selectedPixmap = m_desktopCapture.crop(selectedRect);
                         // 处理截图结果
                         handleScreenshotResult(selectedPixmap);
                     }
 
-                    // 关闭并标记删除选择窗口
-                    m_selectionWidget->removeEventFilter(this); // 移除过滤器
-                    m_selectionWidget->close();
-                    m_selectionWidget->deleteLater(); // 安全删除
+                    // 隐藏选择窗口，留待下次使用
+                    cleanupScreenshot();
 
                     return true; // 事件已处理
                 }
@@ -448,28 +1026,25 @@ bool MainWindow::eventFilter(QObject *watched, QEvent *event)
             case QEvent::KeyPress: {
                 QKeyEvent *keyEvent = static_cast<QKeyEvent*>(event);
                 if (keyEvent->key() == Qt::Key_Escape) {
-                    m_isSelecting = false;
-                    // 关闭并标记删除选择窗口
-                    m_selectionWidget->removeEventFilter(this); // 移除过滤器
-                    m_selectionWidget->close();
-                    m_selectionWidget->deleteLater(); // 安全删除
-                    // 如果用户取消截图，也需要显示主窗口
-                     if (!this->isVisible()) {
-                         this->show();
-                         this->activateWindow();
-                     }
+                    // 隐藏选择窗口；用户取消截图时也需要显示主窗口
+                    cleanupScreenshot();
                     return true; // 事件已处理
                 }
                 break;
             }
              case QEvent::Paint: {
-                  // 在选择窗口上绘制背景和半透明遮罩
-                  if (m_selectionWidget && !m_fullScreenshot.isNull()) {
+                  // 只绘制需要更新的区域：选区外复制变暗的背景，选区内复制原图
+                  if (m_selectionWidget && !m_desktopCapture.isNull()) {
+                      // 第一次绘制时选区窗口即将出现在屏幕上，记录从触发截图开始的延迟
+                      if (!m_overlayPainted) {
+                          m_overlayPainted = true;
+                          qDebug() << "截图：从触发到选区窗口显示" << m_screenshotTimer.elapsed() << "ms"
+                                   << (m_overlayWasCold ? "（新建窗口）" : "（复用窗口）");
+                      }
                       QPainter painter(m_selectionWidget);
-                      // 绘制背景图
-                      painter.drawPixmap(0, 0, m_fullScreenshot);
-                      // 绘制半透明遮罩
-                      painter.fillRect(m_selectionWidget->rect(), QColor(0, 0, 0, 70));
+                      painter.setCompositionMode(QPainter::CompositionMode_Source);
+                      m_desktopCapture.paint(&painter, static_cast<QPaintEvent*>(event)->rect(),
+                                             m_rubberBand->isVisible() ? m_rubberBand->geometry() : QRect());
                   }
                  // 不返回true，让窗口继续处理绘制
                  break;
@@ -492,6 +1067,18 @@ void MainWindow::loadSettings()
     if (settings.contains("windowGeometry")) {
         restoreGeometry(settings.value("windowGeometry").toByteArray());
     }
+
+    exportPadding = qMax(0, settings.value("exportPadding", 0).toInt());
+    hibernateAfterMinutes = qMax(0, settings.value("hibernateAfterMinutes", 10).toInt());
+    memoryBudgetMB = qMax(64, settings.value("memoryBudgetMB", 1024).toInt());
+    smoothZoom = settings.value("smoothZoom", true).toBool();
+    adaptiveRenderQuality = settings.value("adaptiveRenderQuality", true).toBool();
+    renderQualityIdleMs = qMax(0, settings.value("renderQualityIdleMs", 250).toInt());
+    tileCacheRendering = settings.value("tileCacheRendering", false).toBool();
+    sceneIndexConfig = SceneIndexConfig::fromSettings();
+    undoMemoryMB = qMax(0, settings.value("undoMemoryMB", 256).toInt());
+    screenshotToClipboard = settings.value("screenshotToClipboard", true).toBool();
+    prewarmScreenshotOverlay = settings.value("prewarmScreenshotOverlay", true).toBool();
 }
 
 void MainWindow::saveSettings()
@@ -499,4 +1086,15 @@ void MainWindow::saveSettings()
     QSettings settings("YourCompany", "EZ Paster");
     // settings.setValue("screenshotHotkeyEnabled", screenshotHotkeyEnabled);
     settings.setValue("windowGeometry", saveGeometry());
+    settings.setValue("exportPadding", exportPadding);
+    settings.setValue("hibernateAfterMinutes", hibernateAfterMinutes);
+    settings.setValue("memoryBudgetMB", memoryBudgetMB);
+    settings.setValue("smoothZoom", smoothZoom);
+    settings.setValue("adaptiveRenderQuality", adaptiveRenderQuality);
+    settings.setValue("renderQualityIdleMs", renderQualityIdleMs);
+    settings.setValue("tileCacheRendering", tileCacheRendering);
+    settings.setValue("undoMemoryMB", undoMemoryMB);
+    settings.setValue("screenshotToClipboard", screenshotToClipboard);
+    settings.setValue("prewarmScreenshotOverlay", prewarmScreenshotOverlay);
+    sceneIndexConfig.save();
 }
@@ -4,6 +4,12 @@
 #include <QMainWindow>
 #include <QPoint>
 #include <QPixmap>
+#include <QPointer>
+#include <QElapsedTimer>
+
+#include "sceneindex.h"
+#include "draftwidget.h"
+#include "desktopcapture.h"
 
 // Forward declarations to reduce header dependencies
 class QAction;
@@ -13,6 +19,10 @@ class QSlider;
 class QLabel;
 class QRubberBand;
 class QEvent;
+class QProgressBar;
+class QPushButton;
+class QTimer;
+class ExportJob;
 
 class MainWindow : public QMainWindow
 {
@@ -28,47 +38,122 @@ protected:
 
 private slots:
     void createNewDraft();
+    void openDraft();
+    void saveDraft();
     void closeDraftTab(int index);
     void exportCurrentDraft();
+    void exportSelection();
+    void exportViewport();
     void updateActions();
     void captureScreenshot();
     void zoomIn();
     void zoomOut();
     void resetZoom();
     void updateZoomLevel(int value);
+    void onDraftZoomChanged(qreal factor);
+    void setAdaptiveRenderQuality(bool enabled);
+    void setTileCacheRendering(bool enabled);
+    void undo();
+    void redo();
+    void flattenSelection();
+    void bringToFront();
+    void sendToBack();
+    // 撤销/重做菜单项跟随当前草稿的撤销栈
+    void updateUndoActions();
     void cleanupScreenshot();
+    // 创建并预热截图选区窗口（只在第一次调用时创建）
+    void ensureSelectionOverlay();
+    // 截图前主窗口已从屏幕上移除（或等待超时）
+    void onMainWindowHidden();
+    void cancelExport();
+    void onExportFinished(bool success, bool cancelled, const QString &errorString);
+    void onCurrentTabChanged(int index);
+    // 休眠长时间未查看的标签页
+    void hibernateIdleTabs();
+    // 刷新状态栏内存统计，超出预算时按最久未查看的顺序释放内存
+    void updateMemoryUsage();
 
 private:
     void setupUI();
     void setupConnections();
     void setupZoomControls();
+    void setupExportControls();
     void loadSettings();
     void saveSettings();
     void applyZoom(qreal factor);
+    void syncZoomControls(qreal factor);
+    // 新建或打开的草稿应用主窗口的缩放设置
+    void initDraft(DraftWidget *draft);
+    void exportDraft(DraftWidget::ExportRegion region);
+    // 内存标签提示中追加的绘制耗时统计，没有数据时为空
+    QString renderQualityTip(DraftWidget *draft) const;
+    // 抓取屏幕并显示选区窗口
+    void startScreenshotSelection();
     void handleScreenshotResult(const QPixmap &pixmap);
+    // 所有草稿，按最久未查看排序，当前标签页在最后
+    QList<DraftWidget*> draftsByLeastRecentlyViewed() const;
 
     QTabWidget *tabWidget;
 
     // Actions
     QAction *newAction;
+    QAction *openAction;
+    QAction *saveAction;
     QAction *exportAction;
+    QAction *exportSelectionAction;
+    QAction *exportViewportAction;
     QAction *quitAction;
     QAction *screenshotAction;
+    QAction *screenshotClipboardAction;
     QAction *zoomInAction;
     QAction *zoomOutAction;
     QAction *resetZoomAction;
+    QAction *adaptiveQualityAction;
+    QAction *tileCacheAction;
+    QAction *undoAction;
+    QAction *redoAction;
+    QAction *flattenAction;
+    QAction *bringToFrontAction;
+    QAction *sendToBackAction;
 
     // Zoom controls
     QSlider *zoomSlider;
     QLabel *zoomLabel;
+    QLabel *memoryLabel;
     qreal zoomFactor;
+    bool smoothZoom; // 缩放时逐帧缓动到目标
+    bool adaptiveRenderQuality; // 新草稿默认在交互时快速绘制
+    int renderQualityIdleMs;    // 输入静止多久后恢复高质量绘制
+    bool tileCacheRendering;    // 新草稿默认使用图块缓存绘制
+    SceneIndexConfig sceneIndexConfig; // 草稿场景的空间索引方式
+    int undoMemoryMB; // 每个草稿撤销历史可以持有的内存
+    bool screenshotToClipboard; // 截图放到草稿后是否再复制到剪贴板
+    bool prewarmScreenshotOverlay; // 启动后预先创建选区窗口；关闭后可以测量新建窗口的延迟
+
+    // Export progress
+    QProgressBar *exportProgressBar;
+    QPushButton *exportCancelButton;
+    ExportJob *m_exportJob;
+    int exportPadding; // 导出内容四周留白（像素）
+
+    // Tab hibernation
+    QTimer *hibernateTimer;
+    QTimer *memoryTimer;
+    QPointer<DraftWidget> m_activeDraft;
+    int hibernateAfterMinutes; // 标签页未被查看超过该时间后休眠
+    int memoryBudgetMB;        // 所有标签页图片内存的预算
 
     // Screenshot temporary members
+    bool m_waitingForHide;          // 已隐藏主窗口，等待它从屏幕上消失
+    QTimer *m_hideFallbackTimer;
+    QElapsedTimer m_screenshotTimer; // 从触发截图开始计时
     QWidget *m_selectionWidget;
     QRubberBand *m_rubberBand;
     QPoint m_selStartPos;
     QPoint m_selEndPos;
     bool m_isSelecting;
-    QPixmap m_fullScreenshot;
+    bool m_overlayWasCold;  // 本次截图是否新建了选区窗口
+    bool m_overlayPainted;  // 本次截图的选区窗口已经绘制过
+    DesktopCapture m_desktopCapture; // 各屏幕的原图和预先叠加了遮罩的副本
 };
 #endif // MAINWINDOW_H 
\ No newline at end of file
@@ -0,0 +1,12 @@
+#ifndef MEMORYUSAGE_H
+#define MEMORYUSAGE_H
+
+#include <QString>
+
+// 进程当前的常驻内存（字节），平台不支持时返回 -1
+qint64 processResidentBytes();
+
+// 按 KB / MB / GB 格式化字节数，用于状态栏显示
+QString formatBytes(qint64 bytes);
+
+#endif // MEMORYUSAGE_H
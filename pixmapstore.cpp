@@ -0,0 +1,90 @@
+#include "pixmapstore.h"
+#include "imagesource.h"
+
+
+PixmapStore &PixmapStore::instance()
+{
+    static PixmapStore store;
+    return store;
+}
+
+quint64 PixmapStore::contentHash(const QImage &image)
+{
+    // 逐行哈希有效像素，忽略行尾的对齐填充
+    const qsizetype lineBytes = qsizetype(image.width()) * image.depth() / 8;
+    quint64 hash = qHash(image.width()) ^ (quint64(qHash(image.height())) << 1) ^ (quint64(image.format()) << 2);
+    for (int y = 0; y < image.height(); ++y) {
+        hash = qHashBits(image.constScanLine(y), size_t(lineBytes), size_t(hash));
+    }
+    return hash;
+}
+
+qint64 PixmapStore::pixmapBytes(const QPixmap &pixmap)
+{
+    return qint64(pixmap.width()) * pixmap.height() * pixmap.depth() / 8;
+}
+
+QPixmap PixmapStore::acquire(const QImage &image)
+{
+    if (image.isNull())
+        return QPixmap();
+
+    // 先转换成 QPixmap 的原生格式，哈希和比较都在同一格式下进行
+    const QImage native = ImageSource::toNativeFormat(image);
+    const quint64 hash = contentHash(native);
+
+    QVector<Entry> &bucket = m_entries[hash];
+    for (Entry &entry : bucket) {
+        // 哈希命中后逐字节比较，避免碰撞导致显示错误的图片
+        if (entry.pixmap.size() == native.size() && entry.pixmap.toImage() == native) {
+            ++entry.refs;
+            m_savedBytes += pixmapBytes(entry.pixmap);
+            return entry.pixmap;
+        }
+    }
+
+    Entry entry;
+    entry.pixmap = QPixmap::fromImage(native);
+    entry.refs = 1;
+    bucket.append(entry);
+    m_cacheKeys.insert(entry.pixmap.cacheKey(), hash);
+    return entry.pixmap;
+}
+
+int PixmapStore::refCount(qint64 cacheKey) const
+{
+    auto keyIt = m_cacheKeys.constFind(cacheKey);
+    if (keyIt == m_cacheKeys.constEnd())
+        return 0;
+
+    for (const Entry &entry : m_entries.value(keyIt.value())) {
+        if (entry.pixmap.cacheKey() == cacheKey)
+            return entry.refs;
+    }
+    return 0;
+}
+
+void PixmapStore::release(qint64 cacheKey)
+{
+    auto keyIt = m_cacheKeys.find(cacheKey);
+    if (keyIt == m_cacheKeys.end())
+        return;
+
+    auto bucketIt = m_entries.find(keyIt.value());
+    QVector<Entry> &bucket = bucketIt.value();
+    for (int i = 0; i < bucket.size(); ++i) {
+        Entry &entry = bucket[i];
+        if (entry.pixmap.cacheKey() != cacheKey)
+            continue;
+
+        if (--entry.refs > 0) {
+            m_savedBytes -= pixmapBytes(entry.pixmap);
+        } else {
+            bucket.removeAt(i);
+            m_cacheKeys.erase(keyIt);
+            if (bucket.isEmpty())
+                m_entries.erase(bucketIt);
+        }
+        return;
+    }
+}
@@ -0,0 +1,45 @@
+#ifndef PIXMAPSTORE_H
+#define PIXMAPSTORE_H
+
+#include <QHash>
+#include <QImage>
+#include <QPixmap>
+#include <QVector>
+
+// 进程内按内容寻址的 QPixmap 仓库。相同内容的图片（例如同一张剪贴板图片
+// 在多个标签页里粘贴多次）共享同一个隐式共享的 QPixmap，只保留一份像素。
+// QPixmap 只能在 GUI 线程使用，仓库同样只在 GUI 线程访问。
+class PixmapStore
+{
+public:
+    static PixmapStore &instance();
+
+    // 返回与 image 内容相同的共享 QPixmap，并增加其引用计数；
+    // 返回的 cacheKey 需要在不再使用时传给 release
+    QPixmap acquire(const QImage &image);
+    void release(qint64 cacheKey);
+    // cacheKey 当前的引用数，不在仓库中时为 0
+    int refCount(qint64 cacheKey) const;
+
+    // 因共享而少分配的像素字节数
+    qint64 savedBytes() const { return m_savedBytes; }
+    int distinctCount() const { return m_cacheKeys.size(); }
+
+private:
+    struct Entry {
+        QPixmap pixmap;
+        int refs = 0;
+    };
+
+    PixmapStore() = default;
+    Q_DISABLE_COPY(PixmapStore)
+
+    static quint64 contentHash(const QImage &image);
+    static qint64 pixmapBytes(const QPixmap &pixmap);
+
+    QHash<quint64, QVector<Entry>> m_entries; // 内容哈希 -> 哈希相同的条目
+    QHash<qint64, quint64> m_cacheKeys;       // QPixmap::cacheKey -> 内容哈希
+    qint64 m_savedBytes = 0;
+};
+
+#endif // PIXMAPSTORE_H
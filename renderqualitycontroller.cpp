@@ -0,0 +1,75 @@
+#include "renderqualitycontroller.h"
+
+#include <QGraphicsView>
+#include <QPainter>
+#include <QTimer>
+
+// 静止多久后恢复高质量绘制
+const int DEFAULT_IDLE_INTERVAL_MS = 250;
+
+RenderQualityController::RenderQualityController(QGraphicsView *view)
+    : QObject(view),
+      m_view(view),
+      m_enabled(true),
+      m_interacting(false)
+{
+    m_idleTimer = new QTimer(this);
+    m_idleTimer->setSingleShot(true);
+    m_idleTimer->setInterval(DEFAULT_IDLE_INTERVAL_MS);
+    connect(m_idleTimer, &QTimer::timeout, this, &RenderQualityController::settle);
+
+    applyRenderHints(false);
+}
+
+void RenderQualityController::setEnabled(bool enabled)
+{
+    if (m_enabled == enabled)
+        return;
+    m_enabled = enabled;
+    if (!enabled && m_interacting) {
+        m_idleTimer->stop();
+        settle();
+    }
+}
+
+void RenderQualityController::setIdleInterval(int ms)
+{
+    m_idleTimer->setInterval(qMax(0, ms));
+}
+
+int RenderQualityController::idleInterval() const
+{
+    return m_idleTimer->interval();
+}
+
+void RenderQualityController::interact()
+{
+    if (!m_enabled)
+        return;
+    if (!m_interacting) {
+        m_interacting = true;
+        applyRenderHints(true);
+    }
+    m_idleTimer->start();
+}
+
+void RenderQualityController::frameRendered(qint64 nsecs)
+{
+    FrameStats &stats = m_interacting ? m_fastFrames : m_qualityFrames;
+    ++stats.frames;
+    stats.totalNs += nsecs;
+}
+
+void RenderQualityController::settle()
+{
+    m_interacting = false;
+    applyRenderHints(false);
+    // 交互中绘制的是低质量内容，静止后整体重绘一次
+    m_view->viewport()->update();
+}
+
+void RenderQualityController::applyRenderHints(bool fast)
+{
+    m_view->setRenderHint(QPainter::Antialiasing, !fast);
+    m_view->setRenderHint(QPainter::SmoothPixmapTransform, !fast);
+}
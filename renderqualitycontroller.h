@@ -0,0 +1,55 @@
+#ifndef RENDERQUALITYCONTROLLER_H
+#define RENDERQUALITYCONTROLLER_H
+
+#include <QObject>
+
+class QGraphicsView;
+class QTimer;
+
+// 交互式绘制质量策略：拖动、平移、缩放时关闭平滑变换和抗锯齿，
+// 输入静止 idleInterval 毫秒后恢复高质量绘制并重绘一次。
+// 图片项根据画笔上的 SmoothPixmapTransform 提示决定是否使用缓存的低分辨率内容。
+class RenderQualityController : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit RenderQualityController(QGraphicsView *view);
+
+    // 关闭时始终使用高质量绘制
+    void setEnabled(bool enabled);
+    bool isEnabled() const { return m_enabled; }
+    void setIdleInterval(int ms);
+    int idleInterval() const;
+
+    // 记录一次交互：切换到快速绘制并重新开始静止计时
+    void interact();
+    bool isInteracting() const { return m_interacting; }
+
+    // 记录一帧的绘制耗时（纳秒），按当前质量分别统计
+    void frameRendered(qint64 nsecs);
+    // 交互中（快速绘制）与静止时（高质量绘制）的平均每帧耗时，没有样本时为 0
+    qreal interactiveFrameMs() const { return m_fastFrames.averageMs(); }
+    qreal qualityFrameMs() const { return m_qualityFrames.averageMs(); }
+
+private slots:
+    void settle();
+
+private:
+    struct FrameStats {
+        qint64 frames = 0;
+        qint64 totalNs = 0;
+        qreal averageMs() const { return frames ? totalNs / 1e6 / frames : 0; }
+    };
+
+    void applyRenderHints(bool fast);
+
+    QGraphicsView *m_view;
+    QTimer *m_idleTimer;
+    bool m_enabled;
+    bool m_interacting;
+    FrameStats m_fastFrames;
+    FrameStats m_qualityFrames;
+};
+
+#endif // RENDERQUALITYCONTROLLER_H
@@ -1,274 +1,379 @@
 #include "resizablepixmapitem.h"
+#include "imagesource.h"
+#include "pixmapstore.h"
 #include <QGraphicsScene>
-#include <QGraphicsSceneHoverEvent>
 #include <QApplication>
+#include <QStyleOptionGraphicsItem>
+#include <QPaintDevice>
+#include <QtMath>
+#include <QRegion>
+#include <QElapsedTimer>
 
-const int HANDLE_SIZE = 10;
+#include <cstring>
+#include <utility>
+
+// 金字塔最小层级的短边像素数，再小就没有意义了
+const int MIN_LEVEL_SIZE = 16;
+
+ResizablePixmapItem::OcclusionStats ResizablePixmapItem::s_occlusionStats;
 
 ResizablePixmapItem::ResizablePixmapItem(const QPixmap &pixmap, QGraphicsItem *parent)
-    : QGraphicsPixmapItem(pixmap, parent), m_resizing(false)
+    : QGraphicsPixmapItem(pixmap, parent),
+      m_storeKey(0),
+      m_lastPainted(0)
 {
     setFlag(QGraphicsItem::ItemIsMovable);
     setFlag(QGraphicsItem::ItemIsSelectable);
-    setFlag(QGraphicsItem::ItemSendsGeometryChanges);
-    setAcceptHoverEvents(true);
-    
-    m_originalSize = pixmap.size();
-    createHandles();
+    // 需要精确的 exposedRect 才能判断暴露区域是否被遮住
+    setFlag(QGraphicsItem::ItemUsesExtendedStyleOption);
+}
+
+ResizablePixmapItem::ResizablePixmapItem(const QImage &image, QGraphicsItem *parent)
+    : ResizablePixmapItem(PixmapStore::instance().acquire(image), parent)
+{
+    m_storeKey = pixmap().cacheKey();
 }
 
 ResizablePixmapItem::~ResizablePixmapItem()
 {
-    // 句柄是这个项的子项，会自动删除
+    if (m_storeKey)
+        PixmapStore::instance().release(m_storeKey);
 }
 
-void ResizablePixmapItem::createHandles()
+void ResizablePixmapItem::clearLevelCache()
 {
-    // 创建四个角落的控制点
-    m_handles[TopLeft] = new ResizeHandle(this, TopLeft);
-    m_handles[TopRight] = new ResizeHandle(this, TopRight);
-    m_handles[BottomLeft] = new ResizeHandle(this, BottomLeft);
-    m_handles[BottomRight] = new ResizeHandle(this, BottomRight);
-    
-    // 默认隐藏控制点，只在选择时显示
-    for (int i = 0; i < 4; ++i) {
-        m_handles[i]->setVisible(false);
-    }
+    m_levels.clear();
 }
 
-void ResizablePixmapItem::updateHandles()
+void ResizablePixmapItem::setPlaceholderSize(const QSizeF &size)
 {
-    QRectF rect = boundingRect();
-    
-    // 更新控制点位置
-    m_handles[TopLeft]->updatePosition();
-    m_handles[TopRight]->updatePosition();
-    m_handles[BottomLeft]->updatePosition();
-    m_handles[BottomRight]->updatePosition();
+    prepareGeometryChange();
+    m_placeholderSize = size;
 }
 
-void ResizablePixmapItem::paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget)
+void ResizablePixmapItem::replacePixmap(const QPixmap &pixmap)
 {
-    QGraphicsPixmapItem::paint(painter, option, widget);
-    
-    // 当项被选中时，显示控制点
-    bool showHandles = isSelected();
-    for (int i = 0; i < 4; ++i) {
-        m_handles[i]->setVisible(showHandles);
+    prepareGeometryChange();
+    clearLevelCache();
+    if (m_storeKey) {
+        PixmapStore::instance().release(m_storeKey);
+        m_storeKey = 0;
     }
+    m_parked = ParkedPixels();
+    setPixmap(pixmap);
 }
 
-QRectF ResizablePixmapItem::boundingRect() const
+void ResizablePixmapItem::setFullResolutionSource(const QSharedPointer<ImageSource> &source)
 {
-    return QGraphicsPixmapItem::boundingRect();
+    prepareGeometryChange();
+    m_fullSource = source;
 }
 
-void ResizablePixmapItem::mousePressEvent(QGraphicsSceneMouseEvent *event)
+bool ResizablePixmapItem::isProxy() const
 {
-    if (event->button() == Qt::LeftButton) {
-        m_startPos = event->pos();
-        m_originalTransform = transform();
-    }
-    QGraphicsPixmapItem::mousePressEvent(event);
+    return m_fullSource && !pixmap().isNull() && pixmap().width() < m_fullSource->size().width();
+}
+
+qreal ResizablePixmapItem::pixelsPerUnit() const
+{
+    const QRectF rect = contentRect();
+    if (pixmap().isNull() || rect.isEmpty())
+        return 1.0;
+    return pixmap().width() / rect.width();
 }
 
-void ResizablePixmapItem::mouseMoveEvent(QGraphicsSceneMouseEvent *event)
+qint64 ResizablePixmapItem::park()
 {
-    QGraphicsPixmapItem::mouseMoveEvent(event);
+    if (isParked() || pixmap().isNull())
+        return 0;
+
+    const QPixmap current = pixmap();
+    if (m_fullSource)
+        return parkCompressed(current, QImage::Format_Invalid, QByteArray());
+
+    // 压缩级别 1：速度优先，截图和界面图片通常有大片相同颜色，压缩率已经足够
+    const QImage image = current.toImage();
+    return parkCompressed(current, image.format(), qCompress(image.constBits(), int(image.sizeInBytes()), 1));
 }
 
-void ResizablePixmapItem::mouseReleaseEvent(QGraphicsSceneMouseEvent *event)
+qint64 ResizablePixmapItem::parkCompressed(const QPixmap &source, QImage::Format format, const QByteArray &compressed)
 {
-    QGraphicsPixmapItem::mouseReleaseEvent(event);
+    // 压缩期间项可能被唤醒、替换了像素或者已经休眠
+    if (isParked() || pixmap().isNull() || pixmap().cacheKey() != source.cacheKey())
+        return 0;
+    if (!m_fullSource && compressed.isEmpty())
+        return 0;
+
+    const QPixmap current = pixmap();
+    qint64 freed = memoryBytes();
+    // 仓库中的像素还被其他项共享时，释放本项的引用并不会真正释放像素
+    if (m_storeKey && PixmapStore::instance().refCount(m_storeKey) > 1)
+        freed -= pixmapBytes(current);
+
+    m_parked.size = current.size();
+    m_parked.devicePixelRatio = current.devicePixelRatio();
+    m_parked.fromStore = m_storeKey != 0;
+    if (!m_fullSource) {
+        m_parked.format = format;
+        m_parked.data = compressed;
+        freed -= m_parked.data.size();
+    }
+
+    // 占位尺寸保持 contentRect 不变，不需要 prepareGeometryChange
+    m_placeholderSize = current.deviceIndependentSize();
+    clearLevelCache();
+    if (m_storeKey) {
+        PixmapStore::instance().release(m_storeKey);
+        m_storeKey = 0;
+    }
+    setPixmap(QPixmap());
+    return freed;
 }
 
-void ResizablePixmapItem::hoverMoveEvent(QGraphicsSceneHoverEvent *event)
+QImage ResizablePixmapItem::parkedImage() const
 {
-    QGraphicsPixmapItem::hoverMoveEvent(event);
-    setCursor(Qt::ArrowCursor);
+    if (m_fullSource)
+        return m_fullSource->read(QRect(), m_parked.size);
+
+    const QByteArray raw = qUncompress(m_parked.data);
+    QImage image(m_parked.size, m_parked.format);
+    if (image.isNull() || raw.size() != image.sizeInBytes())
+        return QImage();
+    memcpy(image.bits(), raw.constData(), size_t(raw.size()));
+    image.setDevicePixelRatio(m_parked.devicePixelRatio);
+    return image;
 }
 
-QVariant ResizablePixmapItem::itemChange(GraphicsItemChange change, const QVariant &value)
+void ResizablePixmapItem::unpark()
 {
-    if (change == ItemSelectedHasChanged) {
-        // 当选中状态改变时更新控制点可见性
-        bool selected = value.toBool();
-        for (int i = 0; i < 4; ++i) {
-            m_handles[i]->setVisible(selected);
-        }
-    } else if (change == ItemTransformHasChanged || change == ItemPositionHasChanged) {
-        // 当变换或位置改变时更新控制点位置
-        updateHandles();
+    if (isParked())
+        restoreParked(parkedImage());
+}
+
+void ResizablePixmapItem::restoreParked(const QImage &image)
+{
+    if (!isParked())
+        return;
+
+    const bool fromStore = m_parked.fromStore;
+    m_parked = ParkedPixels();
+    if (image.isNull())
+        return; // 来源文件已不可用，保持占位
+
+    if (fromStore) {
+        setPixmap(PixmapStore::instance().acquire(image));
+        m_storeKey = pixmap().cacheKey();
+    } else {
+        setPixmap(QPixmap::fromImage(image));
     }
-    
-    return QGraphicsPixmapItem::itemChange(change, value);
 }
 
-// ResizeHandle 实现
+qint64 ResizablePixmapItem::monotonicMs()
+{
+    static QElapsedTimer clock;
+    if (!clock.isValid())
+        clock.start();
+    // 加 1 保证绘制过的项不会与“从未绘制”的 0 混淆
+    return clock.elapsed() + 1;
+}
 
-ResizeHandle::ResizeHandle(ResizablePixmapItem *parent, ResizablePixmapItem::HandlePosition position)
-    : QGraphicsRectItem(0, 0, HANDLE_SIZE, HANDLE_SIZE, parent),
-      m_parent(parent), m_position(position), m_isResizing(false)
+qint64 ResizablePixmapItem::memoryBytes() const
 {
-    setFlag(QGraphicsItem::ItemIsMovable, false);
-    setFlag(QGraphicsItem::ItemIsSelectable, false);
-    setFlag(QGraphicsItem::ItemSendsGeometryChanges, false);
-    setFlag(QGraphicsItem::ItemIgnoresTransformations, true);
-    setAcceptHoverEvents(true);
-    
-    // 设置控制点样式
-    setPen(QPen(Qt::white, 1));
-    setBrush(QBrush(Qt::blue));
-    
-    updatePosition();
-    
-    // 设置不同角落的光标
-    switch (position) {
-        case ResizablePixmapItem::TopLeft:
-        case ResizablePixmapItem::BottomRight:
-            setCursor(Qt::SizeFDiagCursor);
-            break;
-        case ResizablePixmapItem::TopRight:
-        case ResizablePixmapItem::BottomLeft:
-            setCursor(Qt::SizeBDiagCursor);
-            break;
+    qint64 bytes = pixmapBytes(pixmap()) + m_parked.data.size();
+    for (const QPixmap &level : m_levels) {
+        bytes += pixmapBytes(level);
     }
+    return bytes;
 }
 
-void ResizeHandle::updatePosition()
+qint64 ResizablePixmapItem::releaseCaches()
 {
-    if (!m_parent)
-        return;
-    
-    QRectF rect = m_parent->boundingRect();
-    QPointF pos;
-    
-    // 计算控制点位置
-    switch (m_position) {
-        case ResizablePixmapItem::TopLeft:
-            pos = rect.topLeft();
-            break;
-        case ResizablePixmapItem::TopRight:
-            pos = rect.topRight();
-            pos.rx() -= HANDLE_SIZE;
-            break;
-        case ResizablePixmapItem::BottomLeft:
-            pos = rect.bottomLeft();
-            pos.ry() -= HANDLE_SIZE;
-            break;
-        case ResizablePixmapItem::BottomRight:
-            pos = rect.bottomRight();
-            pos.rx() -= HANDLE_SIZE;
-            pos.ry() -= HANDLE_SIZE;
-            break;
+    qint64 freed = 0;
+    for (const QPixmap &level : std::as_const(m_levels)) {
+        freed += pixmapBytes(level);
+    }
+    clearLevelCache();
+    return freed;
+}
+
+QPixmap ResizablePixmapItem::levelForScale(qreal scale, bool buildMissing) const
+{
+    const QPixmap source = pixmap();
+    if (source.isNull() || scale > 0.5)
+        return source;
+
+    // scale 落在 (1/2^(k+1), 1/2^k] 时使用第 k 层
+    int level = qFloor(std::log2(1.0 / scale));
+    const int shortSide = qMin(source.width(), source.height());
+    while (level > 0 && (shortSide >> level) < MIN_LEVEL_SIZE) {
+        --level;
+    }
+    if (level == 0)
+        return source;
+
+    // 交互过程中不生成新层级，用已有的最接近的层级代替，避免拖动和缩放时卡顿
+    if (!buildMissing && m_levels.size() < level)
+        return m_levels.isEmpty() ? source : m_levels.last();
+
+    // 从上一层逐级减半生成，质量接近盒式滤波且每层只算一次
+    while (m_levels.size() < level) {
+        const QPixmap &previous = m_levels.isEmpty() ? source : m_levels.last();
+        m_levels.append(previous.scaled(qMax(1, previous.width() / 2), qMax(1, previous.height() / 2),
+                                        Qt::IgnoreAspectRatio, Qt::SmoothTransformation));
     }
-    
-    // 转换到场景坐标
-    QPointF scenePos = m_parent->mapToScene(pos);
-    // 转换回控制点的父项坐标系（这里是ResizablePixmapItem）
-    QPointF localPos = m_parent->mapFromScene(scenePos);
-    
-    setPos(localPos);
+    return m_levels.at(level - 1);
 }
 
-void ResizeHandle::paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget)
+bool ResizablePixmapItem::isOpaque() const
 {
-    QGraphicsRectItem::paint(painter, option, widget);
+    return !pixmap().isNull() && !pixmap().hasAlphaChannel() && effectiveOpacity() >= 1.0;
 }
 
-void ResizeHandle::mousePressEvent(QGraphicsSceneMouseEvent *event)
+QPainterPath ResizablePixmapItem::opaqueArea() const
 {
-    if (event->button() == Qt::LeftButton) {
-        m_isResizing = true;
-        m_startPos = event->scenePos();
-        m_startSize = m_parent->boundingRect().size();
-        m_startTransform = m_parent->transform();
-        event->accept();
-    } else {
-        QGraphicsRectItem::mousePressEvent(event);
+    if (!isOpaque())
+        return QPainterPath();
+    QPainterPath path;
+    path.addRect(contentRect());
+    return path;
+}
+
+static qint64 regionArea(const QRegion &region)
+{
+    qint64 area = 0;
+    for (const QRect &rect : region) {
+        area += qint64(rect.width()) * rect.height();
     }
+    return area;
 }
 
-void ResizeHandle::mouseMoveEvent(QGraphicsSceneMouseEvent *event)
+bool ResizablePixmapItem::clipOccludedRegion(QPainter *painter, const QRectF &exposed, QRectF *visibleRect) const
 {
-    if (m_isResizing && m_parent) {
-        QPointF delta = event->scenePos() - m_startPos;
-        
-        // 计算缩放比例
-        qreal scaleX = 1.0;
-        qreal scaleY = 1.0;
-        
-        QRectF rect = m_parent->boundingRect();
-        QPointF center = rect.center();
-        
-        // 根据不同的控制点位置计算缩放方向
-        switch (m_position) {
-            case ResizablePixmapItem::TopLeft:
-                scaleX = 1.0 - delta.x() / rect.width();
-                scaleY = 1.0 - delta.y() / rect.height();
-                break;
-            case ResizablePixmapItem::TopRight:
-                scaleX = 1.0 + delta.x() / rect.width();
-                scaleY = 1.0 - delta.y() / rect.height();
-                break;
-            case ResizablePixmapItem::BottomLeft:
-                scaleX = 1.0 - delta.x() / rect.width();
-                scaleY = 1.0 + delta.y() / rect.height();
-                break;
-            case ResizablePixmapItem::BottomRight:
-                scaleX = 1.0 + delta.x() / rect.width();
-                scaleY = 1.0 + delta.y() / rect.height();
-                break;
-        }
-        
-        // 使用平均缩放比例实现等比例缩放
-        qreal scale = (scaleX + scaleY) / 2.0;
-        
-        // 应用变换
-        QTransform transform;
-        transform.translate(center.x(), center.y());
-        transform.scale(scale, scale);
-        transform.translate(-center.x(), -center.y());
-        
-        m_parent->setTransform(transform);
-        
-        // 更新所有控制点位置
-        m_parent->updateHandles();
-        
-        event->accept();
-    } else {
-        QGraphicsRectItem::mouseMoveEvent(event);
+    if (visibleRect)
+        *visibleRect = exposed;
+
+    QGraphicsScene *itemScene = scene();
+    if (!itemScene || exposed.isEmpty())
+        return true;
+
+    // 在 painter 的设备坐标中计算，视图和导出使用同一套逻辑
+    const QTransform itemToDevice = painter->worldTransform();
+    const QTransform sceneToDevice = sceneTransform().inverted() * itemToDevice;
+    if (sceneToDevice.type() > QTransform::TxScale)
+        return true;
+
+    const QRectF exposedScene = sceneTransform().mapRect(exposed);
+    const QRect exposedDevice = itemToDevice.mapRect(exposed).toAlignedRect();
+
+    // 自上而下遍历，直到遇到本项；只有轴对齐的不透明项才参与遮挡
+    QRegion covered;
+    const QList<QGraphicsItem*> above = itemScene->items(exposedScene, Qt::IntersectsItemBoundingRect,
+                                                         Qt::DescendingOrder);
+    for (QGraphicsItem *item : above) {
+        if (item == this)
+            break;
+        const ResizablePixmapItem *other = dynamic_cast<const ResizablePixmapItem*>(item);
+        if (!other || !other->isVisible() || !other->isOpaque())
+            continue;
+        const QTransform otherToDevice = other->sceneTransform() * sceneToDevice;
+        if (otherToDevice.type() > QTransform::TxScale)
+            continue;
+
+        // 向内取整，部分覆盖的边缘像素仍然绘制
+        const QRectF rect = otherToDevice.mapRect(other->contentRect());
+        const QRect inner(QPoint(qCeil(rect.left()), qCeil(rect.top())),
+                          QPoint(qFloor(rect.right()) - 1, qFloor(rect.bottom()) - 1));
+        if (inner.isValid())
+            covered += inner;
+    }
+    if (covered.isEmpty())
+        return true;
+
+    const QRegion visible = QRegion(exposedDevice).subtracted(covered);
+    s_occlusionStats.skippedPixels += qint64(exposedDevice.width()) * exposedDevice.height() - regionArea(visible);
+    if (visible.isEmpty()) {
+        ++s_occlusionStats.skippedPaints;
+        return false;
     }
+
+    if (visibleRect)
+        *visibleRect = itemToDevice.inverted().mapRect(QRectF(visible.boundingRect()));
+
+    // 裁剪区域在设置时的坐标系中生效，之后恢复变换不会移动它
+    painter->setWorldTransform(QTransform());
+    painter->setClipRegion(visible, Qt::IntersectClip);
+    painter->setWorldTransform(itemToDevice);
+    return true;
 }
 
-void ResizeHandle::mouseReleaseEvent(QGraphicsSceneMouseEvent *event)
+void ResizablePixmapItem::paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget)
 {
-    if (m_isResizing) {
-        m_isResizing = false;
-        event->accept();
-    } else {
-        QGraphicsRectItem::mouseReleaseEvent(event);
+    Q_UNUSED(widget);
+
+    if (isPlaceholder()) {
+        painter->fillRect(contentRect(), QColor(235, 235, 235));
+        painter->setPen(QPen(Qt::gray, 0, Qt::DashLine));
+        painter->drawRect(contentRect());
+        return;
+    }
+
+    // 被上方不透明项完全遮住时跳过，部分遮住时只绘制露出的部分
+    painter->save();
+    if (!clipOccludedRegion(painter, option->exposedRect.intersected(contentRect()))) {
+        painter->restore();
+        return;
     }
+    markPainted();
+
+    // 按实际设备缩放选择金字塔层级，缩小显示时绘制开销与屏幕像素数而非源图像素数相关
+    // 代理图的像素数少于项尺寸，按 pixmap 实际像素换算设备缩放
+    const qreal deviceScale = QStyleOptionGraphicsItem::levelOfDetailFromTransform(painter->worldTransform())
+                              * painter->device()->devicePixelRatioF() / pixelsPerUnit();
+    // 平滑变换由视图的绘制质量策略决定：交互时关闭，静止后开启
+    const bool highQuality = painter->testRenderHint(QPainter::SmoothPixmapTransform);
+    const QPixmap level = levelForScale(deviceScale, highQuality);
+
+    painter->drawPixmap(contentRect(), level, QRectF(level.rect()));
+    painter->restore();
 }
 
-void ResizeHandle::hoverEnterEvent(QGraphicsSceneHoverEvent *event)
+QRectF ResizablePixmapItem::boundingRect() const
 {
-    // 鼠标进入控制点时改变光标
-    switch (m_position) {
-        case ResizablePixmapItem::TopLeft:
-        case ResizablePixmapItem::BottomRight:
-            setCursor(Qt::SizeFDiagCursor);
-            break;
-        case ResizablePixmapItem::TopRight:
-        case ResizablePixmapItem::BottomLeft:
-            setCursor(Qt::SizeBDiagCursor);
-            break;
+    return contentRect();
+}
+
+QRectF ResizablePixmapItem::contentRect() const
+{
+    if (m_fullSource)
+        return QRectF(offset(), QSizeF(m_fullSource->size()));
+    if (pixmap().isNull())
+        return QRectF(offset(), m_placeholderSize);
+    return QRectF(offset(), pixmap().deviceIndependentSize());
+}
+
+QImage ResizablePixmapItem::toImage() const
+{
+    if (m_fullSource && (pixmap().isNull() || isProxy())) {
+        const QImage image = m_fullSource->read();
+        // 来源文件已被删除或移动时退回到内存中的代理图，总比丢失整张图好
+        if (!image.isNull() || pixmap().isNull())
+            return image;
+        return pixmap().toImage();
     }
-    QGraphicsRectItem::hoverEnterEvent(event);
+    if (isParked())
+        return parkedImage();
+    return pixmap().toImage();
 }
 
-void ResizeHandle::hoverLeaveEvent(QGraphicsSceneHoverEvent *event)
+QSharedPointer<ImageSource> ResizablePixmapItem::imageSource() const
 {
-    setCursor(Qt::ArrowCursor);
-    QGraphicsRectItem::hoverLeaveEvent(event);
-} 
\ No newline at end of file
+    // 只有代理图（或尚未解码、已休眠的项）需要在导出时从来源重新解码，
+    // 其余情况直接使用内存中的像素
+    if (m_fullSource && (pixmap().isNull() || isProxy())) {
+        // 代理图的来源文件已不可读时改用内存中的像素导出
+        if (!pixmap().isNull() && !m_fullSource->isAvailable())
+            return QSharedPointer<ImageSource>();
+        return m_fullSource;
+    }
+    return QSharedPointer<ImageSource>();
+}
\ No newline at end of file
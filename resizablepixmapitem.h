@@ -2,12 +2,18 @@
 #define RESIZABLEPIXMAPITEM_H
 
 #include <QGraphicsPixmapItem>
-#include <QGraphicsSceneMouseEvent>
 #include <QPainter>
 #include <QCursor>
+#include <QVector>
+#include <QSharedPointer>
+#include <QByteArray>
+#include <QImage>
+#include <QPainterPath>
 
-class ResizeHandle;
+class ImageSource;
 
+// 可移动、可缩放的图片项。选中时的边框和四角控制点由 DraftWidget 在前景层
+// 统一绘制并做几何命中测试，每张图片在场景中只对应一个项。
 class ResizablePixmapItem : public QGraphicsPixmapItem
 {
 public:
@@ -18,53 +24,110 @@ public:
         BottomRight
     };
 
+    // 休眠项保存的像素信息
+    struct ParkedPixels {
+        QByteArray data; // qCompress 压缩后的扫描线，来自文件的项为空
+        QSize size;
+        QImage::Format format = QImage::Format_Invalid;
+        qreal devicePixelRatio = 1.0;
+        bool fromStore = false;
+    };
+
     ResizablePixmapItem(const QPixmap &pixmap, QGraphicsItem *parent = nullptr);
+    // 像素取自 PixmapStore，内容相同的项共享同一份 QPixmap
+    explicit ResizablePixmapItem(const QImage &image, QGraphicsItem *parent = nullptr);
     ~ResizablePixmapItem();
 
     void paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget = nullptr) override;
     QRectF boundingRect() const override;
+    // 完全不透明的项声明整个内容区域为不透明，供遮挡剔除使用
+    QPainterPath opaqueArea() const override;
+    virtual bool isOpaque() const;
 
-protected:
-    void mousePressEvent(QGraphicsSceneMouseEvent *event) override;
-    void mouseMoveEvent(QGraphicsSceneMouseEvent *event) override;
-    void mouseReleaseEvent(QGraphicsSceneMouseEvent *event) override;
-    void hoverMoveEvent(QGraphicsSceneHoverEvent *event) override;
-    QVariant itemChange(GraphicsItemChange change, const QVariant &value) override;
+    // 遮挡剔除统计：被上方不透明项完全遮住而跳过的绘制次数，以及少绘制的像素数
+    struct OcclusionStats {
+        qint64 skippedPaints = 0;
+        qint64 skippedPixels = 0;
+    };
+    static OcclusionStats occlusionStats() { return s_occlusionStats; }
 
-private:
-    void updateHandles();
-    void createHandles();
-
-    bool m_resizing;
-    QPointF m_startPos;
-    QSizeF m_originalSize;
-    QTransform m_originalTransform;
-    ResizeHandle *m_handles[4]; // 四个角落的控制点
-    friend class ResizeHandle;
-};
+    // 项坐标系中图像占据的区域
+    virtual QRectF contentRect() const;
+    // 全分辨率图像，用于导出和保存
+    virtual QImage toImage() const;
+    // 可在工作线程中按区域解码的图像来源，没有时返回空指针
+    virtual QSharedPointer<ImageSource> imageSource() const;
 
-class ResizeHandle : public QGraphicsRectItem
-{
-public:
-    ResizeHandle(ResizablePixmapItem *parent, ResizablePixmapItem::HandlePosition position);
-    
-    void updatePosition();
-    void paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget = nullptr) override;
+    // 丢弃已生成的降采样层级，像素变化后必须调用
+    void clearLevelCache();
+
+    // 占位：像素尚未解码完成时按给定尺寸绘制灰色占位框
+    void setPlaceholderSize(const QSizeF &size);
+    bool isPlaceholder() const { return pixmap().isNull() && (m_fullSource || !m_placeholderSize.isEmpty()); }
+    // 替换像素（例如占位项解码完成），同时清除降采样缓存
+    void replacePixmap(const QPixmap &pixmap);
+
+    // 全分辨率来源。设置后项的尺寸由来源决定，pixmap 可以是降采样的代理图，
+    // 导出和保存时从来源重新解码全分辨率像素
+    void setFullResolutionSource(const QSharedPointer<ImageSource> &source);
+    QSharedPointer<ImageSource> fullResolutionSource() const { return m_fullSource; }
+    // pixmap 的分辨率低于来源时为代理图
+    bool isProxy() const;
+    // pixmap 每个项坐标单位对应的像素数
+    qreal pixelsPerUnit() const;
+
+    // 休眠：像素压缩为内存中的数据块（来自文件的项直接丢弃，唤醒时重新解码），
+    // 项的几何保持不变，期间绘制为占位框；返回大约释放的字节数。
+    // park/unpark 在调用线程中压缩和解码，GUI 线程上应在工作线程中完成后
+    // 调用 parkCompressed/restoreParked
+    virtual qint64 park();
+    virtual void unpark();
+    // compressed 为 source（休眠前的 pixmap）扫描线的压缩数据，来自文件的项为空；
+    // 期间 pixmap 已被替换时不休眠，返回 0
+    qint64 parkCompressed(const QPixmap &source, QImage::Format format, const QByteArray &compressed);
+    // 用工作线程中解压或解码得到的像素唤醒，image 为空时保持占位
+    void restoreParked(const QImage &image);
+    bool isParked() const { return m_parked.size.isValid(); }
+    const ParkedPixels &parkedPixels() const { return m_parked; }
+
+    // 本项持有的内存：像素、降采样层级、分块缓存以及休眠后的压缩数据
+    virtual qint64 memoryBytes() const;
+    // 释放可以重新生成的缓存（降采样层级、图块），返回释放的字节数
+    virtual qint64 releaseCaches();
+    // 最近一次绘制的时间（单调时钟毫秒），从未绘制过时为 0
+    qint64 lastPaintedMs() const { return m_lastPainted; }
+    static qint64 monotonicMs();
+
+    // 来自 PixmapStore 时为 pixmap 的 cacheKey，否则为 0
+    qint64 storeKey() const { return m_storeKey; }
+
+    static qint64 pixmapBytes(const QPixmap &pixmap)
+    {
+        return qint64(pixmap.width()) * pixmap.height() * pixmap.depth() / 8;
+    }
 
 protected:
-    void mousePressEvent(QGraphicsSceneMouseEvent *event) override;
-    void mouseMoveEvent(QGraphicsSceneMouseEvent *event) override;
-    void mouseReleaseEvent(QGraphicsSceneMouseEvent *event) override;
-    void hoverEnterEvent(QGraphicsSceneHoverEvent *event) override;
-    void hoverLeaveEvent(QGraphicsSceneHoverEvent *event) override;
+    void markPainted() { m_lastPainted = monotonicMs(); }
+    // 把 exposed（项坐标）中被上方不透明项遮住的部分从 painter 的裁剪区域中去掉；
+    // 全部被遮住时返回 false，调用方应跳过绘制。调用前需要 painter->save()。
+    // visibleRect 返回仍需绘制部分的外接矩形（项坐标）
+    bool clipOccludedRegion(QPainter *painter, const QRectF &exposed, QRectF *visibleRect = nullptr) const;
 
 private:
-    ResizablePixmapItem *m_parent;
-    ResizablePixmapItem::HandlePosition m_position;
-    QPointF m_startPos;
-    QSizeF m_startSize;
-    QTransform m_startTransform;
-    bool m_isResizing;
+    // 解压休眠的像素，不改变项的状态
+    QImage parkedImage() const;
+    // 返回分辨率不低于 scale（设备像素 / 源像素）的最小金字塔层级；
+    // buildMissing 为 false 时只使用已生成的层级
+    QPixmap levelForScale(qreal scale, bool buildMissing = true) const;
+
+    QSizeF m_placeholderSize;
+    QSharedPointer<ImageSource> m_fullSource;
+    qint64 m_storeKey; // 来自 PixmapStore 时为 pixmap 的 cacheKey，否则为 0
+    ParkedPixels m_parked;
+    qint64 m_lastPainted;
+
+    static OcclusionStats s_occlusionStats;
+    mutable QVector<QPixmap> m_levels; // 第 i 项为 1/2^(i+1) 分辨率的层级
 };
 
 #endif // RESIZABLEPIXMAPITEM_H 
\ No newline at end of file
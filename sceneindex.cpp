@@ -0,0 +1,44 @@
+#include "sceneindex.h"
+
+#include <QSettings>
+
+SceneIndexConfig SceneIndexConfig::fromSettings()
+{
+    QSettings settings("YourCompany", "EZ Paster");
+    SceneIndexConfig config;
+    config.useBspTree = settings.value("sceneIndex/bspTree", config.useBspTree).toBool();
+    config.bspTreeDepth = qBound(0, settings.value("sceneIndex/bspTreeDepth", config.bspTreeDepth).toInt(), 32);
+    config.bulkLoadThreshold = qMax(2, settings.value("sceneIndex/bulkLoadThreshold", config.bulkLoadThreshold).toInt());
+    return config;
+}
+
+void SceneIndexConfig::save() const
+{
+    QSettings settings("YourCompany", "EZ Paster");
+    settings.setValue("sceneIndex/bspTree", useBspTree);
+    settings.setValue("sceneIndex/bspTreeDepth", bspTreeDepth);
+    settings.setValue("sceneIndex/bulkLoadThreshold", bulkLoadThreshold);
+}
+
+void applySceneIndexConfig(QGraphicsScene *scene, const SceneIndexConfig &config)
+{
+    scene->setItemIndexMethod(config.useBspTree ? QGraphicsScene::BspTreeIndex : QGraphicsScene::NoIndex);
+    // 切换索引方式会重新创建索引，深度需要在之后设置
+    if (config.useBspTree)
+        scene->setBspTreeDepth(config.bspTreeDepth);
+}
+
+SceneBulkLoadGuard::SceneBulkLoadGuard(QGraphicsScene *scene)
+    : m_scene(scene),
+      m_method(scene->itemIndexMethod()),
+      m_bspTreeDepth(scene->bspTreeDepth())
+{
+    m_scene->setItemIndexMethod(QGraphicsScene::NoIndex);
+}
+
+SceneBulkLoadGuard::~SceneBulkLoadGuard()
+{
+    m_scene->setItemIndexMethod(m_method);
+    if (m_method == QGraphicsScene::BspTreeIndex)
+        m_scene->setBspTreeDepth(m_bspTreeDepth);
+}
@@ -0,0 +1,37 @@
+#ifndef SCENEINDEX_H
+#define SCENEINDEX_H
+
+#include <QGraphicsScene>
+
+// 草稿场景的空间索引配置。默认使用 BSP 树并由 Qt 按项数自动选择深度；
+// 默认值未经测量，可以用 ez-paster --benchmark-index --save 在目标机器上比较各方案，
+// 并把推荐的配置写入 QSettings。
+struct SceneIndexConfig
+{
+    bool useBspTree = true;
+    int bspTreeDepth = 0; // 0 表示由 Qt 根据项数自动选择
+    int bulkLoadThreshold = 2; // 一次加入或移除至少这么多项时使用 SceneBulkLoadGuard
+
+    static SceneIndexConfig fromSettings();
+    void save() const;
+};
+
+void applySceneIndexConfig(QGraphicsScene *scene, const SceneIndexConfig &config);
+
+// 批量加入项（打开草稿、一次拖入多张图片）时暂停索引：构造时切换到 NoIndex，
+// 析构时恢复原来的索引方式和深度，BSP 树只在最后重建一次
+class SceneBulkLoadGuard
+{
+public:
+    explicit SceneBulkLoadGuard(QGraphicsScene *scene);
+    ~SceneBulkLoadGuard();
+
+private:
+    Q_DISABLE_COPY(SceneBulkLoadGuard)
+
+    QGraphicsScene *m_scene;
+    QGraphicsScene::ItemIndexMethod m_method;
+    int m_bspTreeDepth;
+};
+
+#endif // SCENEINDEX_H
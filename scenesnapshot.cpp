@@ -0,0 +1,127 @@
+#include "scenesnapshot.h"
+#include "resizablepixmapitem.h"
+
+#include <QGraphicsScene>
+#include <QHash>
+#include <QMutex>
+#include <QPaintDevice>
+#include <QPainter>
+#include <QStyleOptionGraphicsItem>
+#include <QtMath>
+
+struct SceneSnapshot::DecodedCache {
+    QMutex mutex;
+    QHash<const ImageSource*, QImage> images;
+};
+
+SceneSnapshot SceneSnapshot::capture(QGraphicsScene *scene, bool selectedOnly, Resolution resolution)
+{
+    SceneSnapshot snapshot;
+    snapshot.m_sceneRect = scene->sceneRect();
+    snapshot.m_decoded = QSharedPointer<DecodedCache>::create();
+
+    // AscendingOrder 为自底向上的堆叠顺序，与绘制顺序一致
+    const QList<QGraphicsItem*> items = scene->items(Qt::AscendingOrder);
+    for (QGraphicsItem *item : items) {
+        ResizablePixmapItem *pixmapItem = dynamic_cast<ResizablePixmapItem*>(item);
+        if (!pixmapItem || !pixmapItem->isVisible())
+            continue;
+        if (selectedOnly && !pixmapItem->isSelected())
+            continue;
+
+        Entry entry;
+        if (resolution == DisplayResolution && pixmapItem->isPlaceholder())
+            entry.placeholder = true;
+        else if (resolution == DisplayResolution && !pixmapItem->pixmap().isNull())
+            entry.image = pixmapItem->pixmap().toImage();
+        else
+            entry.source = pixmapItem->imageSource();
+        if (!entry.placeholder && !entry.source && entry.image.isNull()) {
+            entry.image = pixmapItem->toImage();
+            if (entry.image.isNull())
+                continue;
+        }
+        entry.rect = pixmapItem->contentRect();
+        entry.transform = pixmapItem->sceneTransform();
+        entry.sceneBounds = entry.transform.mapRect(entry.rect);
+        entry.opacity = pixmapItem->effectiveOpacity();
+        snapshot.m_entries.append(entry);
+    }
+
+    return snapshot;
+}
+
+QImage SceneSnapshot::decodeWhole(const QSharedPointer<ImageSource> &source) const
+{
+    // 解码期间持有锁：其他线程需要同一来源时等待这一次解码，而不是各自再解码一次
+    QMutexLocker locker(&m_decoded->mutex);
+    auto it = m_decoded->images.constFind(source.data());
+    if (it != m_decoded->images.constEnd())
+        return it.value();
+    const QImage image = source->read();
+    m_decoded->images.insert(source.data(), image);
+    return image;
+}
+
+void SceneSnapshot::paint(QPainter *painter, const QRectF &exposed) const
+{
+    const QTransform base = painter->worldTransform();
+    const qreal devicePixelRatio = painter->device() ? painter->device()->devicePixelRatioF() : 1.0;
+    for (const Entry &entry : m_entries) {
+        if (!entry.sceneBounds.intersects(exposed))
+            continue;
+
+        painter->setWorldTransform(entry.transform * base);
+        painter->setOpacity(entry.opacity);
+
+        if (entry.placeholder) {
+            painter->fillRect(entry.rect, QColor(235, 235, 235));
+            painter->setPen(QPen(Qt::gray, 0, Qt::DashLine));
+            painter->setBrush(Qt::NoBrush);
+            painter->drawRect(entry.rect);
+            continue;
+        }
+        if (!entry.source) {
+            painter->drawImage(entry.rect, entry.image);
+            continue;
+        }
+
+        // 只解码与 exposed 相交的部分，内存占用与条带大小相关
+        const QSize sourceSize = entry.source->size();
+        const qreal sx = sourceSize.width() / entry.rect.width();
+        const qreal sy = sourceSize.height() / entry.rect.height();
+        const QRectF local = entry.transform.inverted().mapRect(exposed).intersected(entry.rect);
+        const QRect clip = QRectF((local.left() - entry.rect.left()) * sx, (local.top() - entry.rect.top()) * sy,
+                                  local.width() * sx, local.height() * sy)
+                               .toAlignedRect()
+                               .intersected(QRect(QPoint(0, 0), sourceSize));
+        if (clip.isEmpty())
+            continue;
+
+        const QRectF target(entry.rect.left() + clip.left() / sx, entry.rect.top() + clip.top() / sy,
+                            clip.width() / sx, clip.height() / sy);
+
+        // 缩小绘制时按设备像素解码，导出（1:1）时仍为全分辨率
+        const qreal deviceScale = QStyleOptionGraphicsItem::levelOfDetailFromTransform(painter->worldTransform())
+                                  * devicePixelRatio / qMin(sx, sy);
+        const QSize scaledSize = deviceScale < 1.0
+                                     ? QSize(qMax(1, qCeil(clip.width() * deviceScale)),
+                                             qMax(1, qCeil(clip.height() * deviceScale)))
+                                     : QSize();
+
+        QImage image;
+        if (entry.source->isFileBacked() && !entry.source->supportsPartialRead()) {
+            const QImage whole = decodeWhole(entry.source);
+            if (whole.isNull())
+                continue;
+            image = whole.copy(clip);
+            if (scaledSize.isValid())
+                image = image.scaled(scaledSize, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+        } else {
+            image = entry.source->read(clip, scaledSize);
+        }
+        painter->drawImage(target, image);
+    }
+    painter->setWorldTransform(base);
+    painter->setOpacity(1.0);
+}
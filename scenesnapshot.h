@@ -0,0 +1,61 @@
+#ifndef SCENESNAPSHOT_H
+#define SCENESNAPSHOT_H
+
+#include <QImage>
+#include <QRectF>
+#include <QTransform>
+#include <QVector>
+#include <QSharedPointer>
+
+#include "imagesource.h"
+
+class QGraphicsScene;
+class QPainter;
+
+// 场景内容的只读快照：在 GUI 线程中采集每个图片项的像素与变换，
+// 之后可以在任意线程中绘制，不再访问 QGraphicsScene 或 QPixmap。
+class SceneSnapshot
+{
+public:
+    struct Entry {
+        QImage image;           // 与项的 QPixmap 共享数据（raster 平台上为浅拷贝）
+        QSharedPointer<ImageSource> source; // 分块项：绘制时只解码需要的区域
+        QRectF rect;            // 项坐标系中的绘制区域
+        QTransform transform;   // 项到场景的变换
+        QRectF sceneBounds;     // 场景坐标中的外接矩形，用于快速剔除
+        qreal opacity = 1.0;
+        bool placeholder = false; // 休眠或仍在加载的项：与视图一样只画占位框
+    };
+
+    SceneSnapshot() = default;
+
+    // 采集哪种分辨率的像素
+    enum Resolution {
+        FullResolution,     // 导出：代理图从来源重新解码全分辨率
+        DisplayResolution   // 屏幕绘制：直接使用项当前显示的像素（代理图、降采样前的 pixmap），
+                            // 休眠项不解压、占位项不解码，与视图一样画占位框
+    };
+
+    // 必须在 GUI 线程中调用；selectedOnly 为 true 时只采集选中的项
+    static SceneSnapshot capture(QGraphicsScene *scene, bool selectedOnly = false,
+                                 Resolution resolution = FullResolution);
+
+    // 绘制与 exposed（场景坐标）相交的项，painter 需已映射到场景坐标。
+    // 分块项按 painter 的设备缩放解码，缩小绘制时不解码全分辨率像素
+    void paint(QPainter *painter, const QRectF &exposed) const;
+
+    QRectF sceneRect() const { return m_sceneRect; }
+    bool isEmpty() const { return m_entries.isEmpty(); }
+
+private:
+    struct DecodedCache;
+
+    // 不支持局部解码的来源整幅解码一次，快照的各个图块和条带共享
+    QImage decodeWhole(const QSharedPointer<ImageSource> &source) const;
+
+    QVector<Entry> m_entries;   // 自底向上的绘制顺序
+    QRectF m_sceneRect;
+    QSharedPointer<DecodedCache> m_decoded; // 快照的副本之间共享
+};
+
+#endif // SCENESNAPSHOT_H
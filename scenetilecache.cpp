@@ -0,0 +1,270 @@
+#include "scenetilecache.h"
+
+#include <QGraphicsScene>
+#include <QPainter>
+#include <QMetaObject>
+#include <QPair>
+#include <QThread>
+#include <QtMath>
+
+#include <cmath>
+#include <utility>
+
+// 每个倍频程的缩放级别数
+const int LEVELS_PER_OCTAVE = 8;
+// 图块缓存默认的内存上限
+const qint64 DEFAULT_MAX_BYTES = qint64(96) * 1024 * 1024;
+
+SceneTileCache::SceneTileCache(QGraphicsScene *scene, QObject *parent)
+    : QObject(parent),
+      m_scene(scene),
+      m_snapshotDirty(true),
+      m_nextRequest(0),
+      m_currentLevel(0),
+      m_currentDevicePixelRatio(1.0),
+      m_bytes(0),
+      m_maxBytes(DEFAULT_MAX_BYTES),
+      m_clock(0)
+{
+    // 留一个核心给 GUI 线程
+    m_pool.setMaxThreadCount(qMax(1, QThread::idealThreadCount() - 1));
+    connect(m_scene, &QGraphicsScene::changed, this, &SceneTileCache::invalidate);
+}
+
+SceneTileCache::~SceneTileCache()
+{
+    // 丢弃尚未开始的任务，等待正在渲染的任务结束
+    m_pool.clear();
+    m_pool.waitForDone();
+}
+
+int SceneTileCache::levelForScale(qreal scale)
+{
+    return qRound(std::log2(scale) * LEVELS_PER_OCTAVE);
+}
+
+qreal SceneTileCache::levelScale(int level)
+{
+    return std::pow(2.0, qreal(level) / LEVELS_PER_OCTAVE);
+}
+
+quint64 SceneTileCache::tileKey(int level, int column, int row)
+{
+    // 级别和行列各占 16/24/24 位，行列可以为负
+    return (quint64(quint16(level)) << 48) | (quint64(quint32(column) & 0xffffff) << 24)
+           | quint64(quint32(row) & 0xffffff);
+}
+
+QRectF SceneTileCache::tileSceneRect(int level, int column, int row, qreal devicePixelRatio)
+{
+    const qreal size = TileSize / (levelScale(level) * devicePixelRatio);
+    return QRectF(column * size, row * size, size, size);
+}
+
+void SceneTileCache::paint(QPainter *painter, const QTransform &viewTransform, const QRect &exposed,
+                           qreal devicePixelRatio)
+{
+    const qreal scale = viewTransform.m11();
+    const int level = levelForScale(scale);
+    if (!qFuzzyCompare(devicePixelRatio, m_currentDevicePixelRatio)) {
+        // 图块的网格和像素都按设备像素比例划分（例如窗口移到另一块屏幕），旧图块全部作废
+        cancelPending();
+        m_tiles.clear();
+        m_bytes = 0;
+        m_currentLevel = level;
+        m_currentDevicePixelRatio = devicePixelRatio;
+    } else if (level != m_currentLevel) {
+        // 缩放级别变化后，排队中的旧级别图块已经没有用处
+        cancelPending();
+        m_currentLevel = level;
+    }
+
+    const QRectF exposedScene = viewTransform.inverted().mapRect(QRectF(exposed));
+    const qreal tileSize = TileSize / (levelScale(level) * devicePixelRatio);
+    const int firstColumn = qFloor(exposedScene.left() / tileSize);
+    const int lastColumn = qFloor(exposedScene.right() / tileSize);
+    const int firstRow = qFloor(exposedScene.top() / tileSize);
+    const int lastRow = qFloor(exposedScene.bottom() / tileSize);
+
+    // 图块边缘四舍五入到整数像素，相邻图块共享同一条边，避免出现缝隙
+    auto targetRect = [&viewTransform](const QRectF &sceneRect) {
+        const QPointF topLeft = viewTransform.map(sceneRect.topLeft());
+        const QPointF bottomRight = viewTransform.map(sceneRect.bottomRight());
+        return QRect(QPoint(qRound(topLeft.x()), qRound(topLeft.y())),
+                     QPoint(qRound(bottomRight.x()) - 1, qRound(bottomRight.y()) - 1));
+    };
+
+    QList<QPair<QRect, const Tile*>> cached;
+    QRectF uncovered;
+    ++m_clock;
+    for (int row = firstRow; row <= lastRow; ++row) {
+        for (int column = firstColumn; column <= lastColumn; ++column) {
+            auto it = m_tiles.find(tileKey(level, column, row));
+            if (it != m_tiles.end()) {
+                it->lastUsed = m_clock;
+                cached.append(qMakePair(targetRect(it->sceneRect), &it.value()));
+            } else {
+                uncovered |= tileSceneRect(level, column, row, devicePixelRatio);
+                requestTile(level, column, row, devicePixelRatio);
+            }
+        }
+    }
+
+    // 缺失的部分先直接渲染场景，再把缓存的图块覆盖上去
+    painter->save();
+    painter->setClipRect(exposed);
+    if (!uncovered.isEmpty()) {
+        uncovered &= exposedScene;
+        m_scene->render(painter, QRectF(viewTransform.mapRect(uncovered)), uncovered, Qt::IgnoreAspectRatio);
+    }
+    painter->setRenderHint(QPainter::SmoothPixmapTransform);
+    for (const auto &entry : cached) {
+        painter->drawImage(entry.first, entry.second->image);
+    }
+    painter->restore();
+}
+
+void SceneTileCache::prefetch(const QRectF &sceneRect, qreal scale, qreal devicePixelRatio)
+{
+    const int level = levelForScale(scale);
+    if (level != m_currentLevel || !qFuzzyCompare(devicePixelRatio, m_currentDevicePixelRatio))
+        return;
+
+    const qreal tileSize = TileSize / (levelScale(level) * devicePixelRatio);
+    for (int row = qFloor(sceneRect.top() / tileSize); row <= qFloor(sceneRect.bottom() / tileSize); ++row) {
+        for (int column = qFloor(sceneRect.left() / tileSize); column <= qFloor(sceneRect.right() / tileSize); ++column) {
+            if (!m_tiles.contains(tileKey(level, column, row)))
+                requestTile(level, column, row, devicePixelRatio);
+        }
+    }
+}
+
+void SceneTileCache::requestTile(int level, int column, int row, qreal devicePixelRatio)
+{
+    const quint64 key = tileKey(level, column, row);
+    if (m_pending.contains(key))
+        return;
+
+    // 快照只在场景变化后的第一次请求时重新采集，像素与项共享；
+    // 休眠项只采集占位框，不会为此解压像素
+    if (m_snapshotDirty) {
+        m_snapshot = SceneSnapshot::capture(m_scene, false, SceneSnapshot::DisplayResolution);
+        m_snapshotDirty = false;
+    }
+
+    Pending pending;
+    pending.request = ++m_nextRequest;
+    pending.sceneRect = tileSceneRect(level, column, row, devicePixelRatio);
+    pending.cancelled = QSharedPointer<QAtomicInt>::create(0);
+    m_pending.insert(key, pending);
+
+    const SceneSnapshot snapshot = m_snapshot;
+    const quint64 request = pending.request;
+    const QRectF sceneRect = pending.sceneRect;
+    const QSharedPointer<QAtomicInt> cancelled = pending.cancelled;
+    const qreal deviceScale = levelScale(level) * devicePixelRatio;
+    const QColor background = m_scene->backgroundBrush().color();
+    m_pool.start([this, key, request, sceneRect, deviceScale, snapshot, background, cancelled]() {
+        if (cancelled->loadRelaxed())
+            return;
+        QImage image(TileSize, TileSize, QImage::Format_ARGB32_Premultiplied);
+        image.fill(background);
+        {
+            QPainter painter(&image);
+            painter.setRenderHint(QPainter::Antialiasing);
+            painter.setRenderHint(QPainter::SmoothPixmapTransform);
+            painter.scale(deviceScale, deviceScale);
+            painter.translate(-sceneRect.topLeft());
+            snapshot.paint(&painter, sceneRect);
+        }
+        QMetaObject::invokeMethod(this, [this, key, request, sceneRect, image]() {
+            onTileRendered(key, request, sceneRect, image);
+        }, Qt::QueuedConnection);
+    });
+}
+
+void SceneTileCache::onTileRendered(quint64 key, quint64 request, const QRectF &sceneRect, const QImage &image)
+{
+    // 请求已被取消（缩放级别变化、缓存被清空或渲染期间该区域发生变化），下次绘制时重新请求
+    auto pending = m_pending.find(key);
+    if (pending == m_pending.end() || pending->request != request)
+        return;
+    m_pending.erase(pending);
+
+    auto existing = m_tiles.find(key);
+    if (existing != m_tiles.end())
+        m_bytes -= existing->image.sizeInBytes();
+
+    Tile tile;
+    tile.image = image;
+    tile.sceneRect = sceneRect;
+    tile.lastUsed = m_clock;
+    m_tiles.insert(key, tile);
+    m_bytes += image.sizeInBytes();
+    evictToBudget();
+
+    emit tileReady(sceneRect);
+}
+
+void SceneTileCache::invalidate(const QList<QRectF> &region)
+{
+    m_snapshotDirty = true;
+
+    auto intersects = [&region](const QRectF &sceneRect) {
+        for (const QRectF &rect : region) {
+            if (rect.intersects(sceneRect))
+                return true;
+        }
+        return false;
+    };
+
+    // 只有与变化区域相交的请求基于过时的快照；其余请求的结果仍然正确，继续渲染
+    for (auto it = m_pending.begin(); it != m_pending.end();) {
+        if (intersects(it->sceneRect)) {
+            it->cancelled->storeRelaxed(1);
+            it = m_pending.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    for (auto it = m_tiles.begin(); it != m_tiles.end();) {
+        if (intersects(it->sceneRect)) {
+            m_bytes -= it->image.sizeInBytes();
+            it = m_tiles.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void SceneTileCache::evictToBudget()
+{
+    while (m_bytes > m_maxBytes && !m_tiles.isEmpty()) {
+        auto oldest = m_tiles.begin();
+        for (auto it = m_tiles.begin(); it != m_tiles.end(); ++it) {
+            if (it->lastUsed < oldest->lastUsed)
+                oldest = it;
+        }
+        m_bytes -= oldest->image.sizeInBytes();
+        m_tiles.erase(oldest);
+    }
+}
+
+void SceneTileCache::cancelPending()
+{
+    for (const Pending &pending : std::as_const(m_pending)) {
+        pending.cancelled->storeRelaxed(1);
+    }
+    m_pending.clear();
+    m_pool.clear();
+}
+
+void SceneTileCache::clear()
+{
+    cancelPending();
+    m_tiles.clear();
+    m_bytes = 0;
+    m_snapshot = SceneSnapshot();
+    m_snapshotDirty = true;
+}
@@ -0,0 +1,87 @@
+#ifndef SCENETILECACHE_H
+#define SCENETILECACHE_H
+
+#include <QObject>
+#include <QHash>
+#include <QImage>
+#include <QList>
+#include <QRectF>
+#include <QSharedPointer>
+#include <QAtomicInt>
+#include <QThreadPool>
+
+#include "scenesnapshot.h"
+
+class QGraphicsScene;
+class QPainter;
+
+// 视口周围场景内容的图块缓存：工作线程根据 SceneSnapshot 把场景栅格化为
+// TileSize 见方的 QImage 图块，视图平移和缩放时直接拼接缓存的图块，
+// 不再逐项绘制。缩放级别按 1/8 倍频程量化，同一级别内的缩放复用同一组图块。
+// 场景发生变化时只丢弃、取消与变化区域相交的图块，其余图块和排队中的请求不受影响。
+class SceneTileCache : public QObject
+{
+    Q_OBJECT
+
+public:
+    static const int TileSize = 256; // 设备像素
+
+    explicit SceneTileCache(QGraphicsScene *scene, QObject *parent = nullptr);
+    ~SceneTileCache() override;
+
+    // 用缓存的图块绘制视口中的 exposed 区域（视口坐标），painter 处于视口坐标系。
+    // 缺失的图块先在 GUI 线程中直接渲染场景，同时提交给工作线程
+    void paint(QPainter *painter, const QTransform &viewTransform, const QRect &exposed, qreal devicePixelRatio);
+    // 预先渲染 sceneRect（场景坐标）范围内在当前缩放下的图块
+    void prefetch(const QRectF &sceneRect, qreal scale, qreal devicePixelRatio);
+
+    void clear();
+    qint64 memoryBytes() const { return m_bytes; }
+    void setMaxBytes(qint64 bytes) { m_maxBytes = bytes; }
+
+signals:
+    // 一个图块渲染完成，rect 为场景坐标
+    void tileReady(const QRectF &rect);
+
+private slots:
+    void invalidate(const QList<QRectF> &region);
+
+private:
+    struct Tile {
+        QImage image;
+        QRectF sceneRect;
+        qint64 lastUsed = 0;
+    };
+
+    // 已提交给工作线程、尚未入缓存的图块
+    struct Pending {
+        quint64 request = 0;    // 请求序号，只接受与当前序号一致的结果
+        QRectF sceneRect;
+        QSharedPointer<QAtomicInt> cancelled; // 置位后尚未开始的任务直接放弃
+    };
+
+    static int levelForScale(qreal scale);
+    static qreal levelScale(int level);
+    static quint64 tileKey(int level, int column, int row);
+    static QRectF tileSceneRect(int level, int column, int row, qreal devicePixelRatio);
+
+    void requestTile(int level, int column, int row, qreal devicePixelRatio);
+    void onTileRendered(quint64 key, quint64 request, const QRectF &sceneRect, const QImage &image);
+    void cancelPending();
+    void evictToBudget();
+
+    QGraphicsScene *m_scene;
+    QThreadPool m_pool;
+    QHash<quint64, Tile> m_tiles;
+    QHash<quint64, Pending> m_pending;
+    SceneSnapshot m_snapshot;
+    bool m_snapshotDirty;
+    quint64 m_nextRequest;
+    int m_currentLevel;
+    qreal m_currentDevicePixelRatio;
+    qint64 m_bytes;
+    qint64 m_maxBytes;
+    qint64 m_clock;
+};
+
+#endif // SCENETILECACHE_H
@@ -0,0 +1,295 @@
+#include "streamingimagewriter.h"
+
+#include <QCoreApplication>
+#include <QtEndian>
+
+#include <cstdlib>
+#include <cstring>
+
+#ifdef EZ_PASTER_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+// 每个 IDAT 块的最大数据量
+const int PNG_CHUNK_BYTES = 64 * 1024;
+
+static QString translate(const char *text)
+{
+    return QCoreApplication::translate("StreamingImageWriter", text);
+}
+
+struct StreamingImageWriter::Deflate {
+#ifdef EZ_PASTER_HAVE_ZLIB
+    z_stream stream;
+#endif
+    QByteArray output;
+};
+
+StreamingImageWriter::StreamingImageWriter(const QString &fileName, const QByteArray &format, int quality)
+    : m_file(fileName),
+      m_format(format.toLower()),
+      m_quality(quality),
+      m_hasAlpha(false),
+      m_rowsWritten(0)
+{
+}
+
+StreamingImageWriter::~StreamingImageWriter()
+{
+    // 没有调用 finish 就销毁时视为放弃
+    if (m_file.isOpen())
+        abort();
+}
+
+bool StreamingImageWriter::supportsFormat(const QByteArray &format)
+{
+    const QByteArray lower = format.toLower();
+#ifdef EZ_PASTER_HAVE_ZLIB
+    if (lower == "png")
+        return true;
+#endif
+    return lower == "bmp" || lower == "dib";
+}
+
+QImage::Format StreamingImageWriter::rowFormat() const
+{
+    if (m_format == "png")
+        return m_hasAlpha ? QImage::Format_RGBA8888 : QImage::Format_RGB888;
+    return QImage::Format_BGR888;
+}
+
+bool StreamingImageWriter::fail(const QString &errorString)
+{
+    m_errorString = errorString;
+    abort();
+    return false;
+}
+
+void StreamingImageWriter::abort()
+{
+#ifdef EZ_PASTER_HAVE_ZLIB
+    if (m_deflate)
+        deflateEnd(&m_deflate->stream);
+#endif
+    m_deflate.reset();
+    if (m_file.isOpen()) {
+        m_file.close();
+        m_file.remove();
+    }
+}
+
+bool StreamingImageWriter::begin(const QSize &size, bool hasAlpha)
+{
+    if (!supportsFormat(m_format)) {
+        m_errorString = translate("不支持逐行写出的图像格式：%1").arg(QString::fromLatin1(m_format));
+        return false;
+    }
+    if (size.isEmpty()) {
+        m_errorString = translate("导出区域为空。");
+        return false;
+    }
+    m_size = size;
+    m_hasAlpha = hasAlpha && m_format == "png";
+    m_rowsWritten = 0;
+
+    if (!m_file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        m_errorString = m_file.errorString();
+        return false;
+    }
+    return m_format == "png" ? beginPng() : beginBmp();
+}
+
+bool StreamingImageWriter::writeRows(const QImage &image, int rows)
+{
+    if (!m_file.isOpen())
+        return false;
+    if (image.width() != m_size.width() || image.format() != rowFormat() || rows > image.height()
+        || m_rowsWritten + rows > m_size.height())
+        return fail(translate("写入的图像行与输出尺寸不一致。"));
+
+    if (m_format == "png")
+        return writePngRows(image, rows);
+
+    // BMP 的每行补齐到 4 字节
+    const qsizetype lineBytes = qsizetype(m_size.width()) * 3;
+    const char padding[4] = {0, 0, 0, 0};
+    const qsizetype paddingBytes = (4 - lineBytes % 4) % 4;
+    for (int row = 0; row < rows; ++row) {
+        if (m_file.write(reinterpret_cast<const char*>(image.constScanLine(row)), lineBytes) != lineBytes
+            || m_file.write(padding, paddingBytes) != paddingBytes)
+            return fail(m_file.errorString());
+    }
+    m_rowsWritten += rows;
+    return true;
+}
+
+bool StreamingImageWriter::finish()
+{
+    if (!m_file.isOpen())
+        return false;
+    if (m_rowsWritten != m_size.height())
+        return fail(translate("图像行没有全部写入。"));
+
+    if (m_format == "png") {
+        if (!drainDeflate(true) || !writePngChunk("IEND", QByteArray()))
+            return false;
+#ifdef EZ_PASTER_HAVE_ZLIB
+        deflateEnd(&m_deflate->stream);
+#endif
+        m_deflate.reset();
+    }
+
+    if (!m_file.flush())
+        return fail(m_file.errorString());
+    m_file.close();
+    return true;
+}
+
+bool StreamingImageWriter::beginBmp()
+{
+    // 负的高度表示自上而下存储，条带可以按渲染顺序直接追加
+    const qint64 lineBytes = (qint64(m_size.width()) * 3 + 3) / 4 * 4;
+    const qint64 imageBytes = lineBytes * m_size.height();
+    const qint64 headerBytes = 14 + 40;
+    if (headerBytes + imageBytes > 0xffffffffLL)
+        return fail(translate("画布过大，超出 BMP 文件的 4 GB 上限。"));
+
+    uchar header[14 + 40];
+    memset(header, 0, sizeof(header));
+    header[0] = 'B';
+    header[1] = 'M';
+    qToLittleEndian<quint32>(quint32(headerBytes + imageBytes), header + 2);
+    qToLittleEndian<quint32>(quint32(headerBytes), header + 10);
+    uchar *info = header + 14;
+    qToLittleEndian<quint32>(40, info);
+    qToLittleEndian<qint32>(m_size.width(), info + 4);
+    qToLittleEndian<qint32>(-m_size.height(), info + 8);
+    qToLittleEndian<quint16>(1, info + 12);       // planes
+    qToLittleEndian<quint16>(24, info + 14);      // 每像素位数
+    qToLittleEndian<quint32>(quint32(imageBytes), info + 20);
+    qToLittleEndian<qint32>(2835, info + 24);     // 72 DPI
+    qToLittleEndian<qint32>(2835, info + 28);
+
+    if (m_file.write(reinterpret_cast<const char*>(header), sizeof(header)) != qint64(sizeof(header)))
+        return fail(m_file.errorString());
+    return true;
+}
+
+#ifdef EZ_PASTER_HAVE_ZLIB
+
+bool StreamingImageWriter::beginPng()
+{
+    static const char signature[8] = {'\x89', 'P', 'N', 'G', '\r', '\n', '\x1a', '\n'};
+    if (m_file.write(signature, sizeof(signature)) != qint64(sizeof(signature)))
+        return fail(m_file.errorString());
+
+    QByteArray header(13, '\0');
+    uchar *data = reinterpret_cast<uchar*>(header.data());
+    qToBigEndian<quint32>(quint32(m_size.width()), data);
+    qToBigEndian<quint32>(quint32(m_size.height()), data + 4);
+    data[8] = 8;                        // 每通道位数
+    data[9] = m_hasAlpha ? 6 : 2;       // RGBA / RGB
+    if (!writePngChunk("IHDR", header))
+        return false;
+
+    // 与 Qt 的 PNG 写入器相同：quality 越高压缩级别越低
+    const int level = m_quality < 0 ? Z_DEFAULT_COMPRESSION : qBound(0, (100 - m_quality) * 9 / 91, 9);
+    m_deflate.reset(new Deflate);
+    memset(&m_deflate->stream, 0, sizeof(m_deflate->stream));
+    if (deflateInit(&m_deflate->stream, level) != Z_OK) {
+        m_deflate.reset();
+        return fail(translate("无法初始化 PNG 压缩。"));
+    }
+    m_deflate->output.resize(PNG_CHUNK_BYTES);
+    m_deflate->stream.next_out = reinterpret_cast<Bytef*>(m_deflate->output.data());
+    m_deflate->stream.avail_out = uInt(PNG_CHUNK_BYTES);
+    m_previousRow = QByteArray(qsizetype(m_size.width()) * (m_hasAlpha ? 4 : 3), '\0');
+    return true;
+}
+
+bool StreamingImageWriter::writePngRows(const QImage &image, int rows)
+{
+    // 每行使用 Paeth 滤波（第一行的上一行视为全 0），截图中大片相同颜色的区域滤波后接近全 0
+    const int bytesPerPixel = m_hasAlpha ? 4 : 3;
+    const qsizetype lineBytes = m_previousRow.size();
+    QByteArray filtered(lineBytes + 1, '\0');
+    filtered[0] = 4;
+
+    for (int row = 0; row < rows; ++row) {
+        const uchar *line = image.constScanLine(row);
+        const uchar *above = reinterpret_cast<const uchar*>(m_previousRow.constData());
+        uchar *out = reinterpret_cast<uchar*>(filtered.data()) + 1;
+        for (qsizetype i = 0; i < lineBytes; ++i) {
+            const int a = i >= bytesPerPixel ? line[i - bytesPerPixel] : 0;
+            const int b = above[i];
+            const int c = i >= bytesPerPixel ? above[i - bytesPerPixel] : 0;
+            const int p = a + b - c;
+            const int pa = std::abs(p - a);
+            const int pb = std::abs(p - b);
+            const int pc = std::abs(p - c);
+            const int predictor = (pa <= pb && pa <= pc) ? a : (pb <= pc ? b : c);
+            out[i] = uchar(line[i] - predictor);
+        }
+        memcpy(m_previousRow.data(), line, size_t(lineBytes));
+
+        m_deflate->stream.next_in = reinterpret_cast<Bytef*>(filtered.data());
+        m_deflate->stream.avail_in = uInt(filtered.size());
+        if (!drainDeflate(false))
+            return false;
+    }
+    m_rowsWritten += rows;
+    return true;
+}
+
+bool StreamingImageWriter::drainDeflate(bool finish)
+{
+    // 压缩输出攒满一个块才写出，避免每行一个小 IDAT 块
+    z_stream &stream = m_deflate->stream;
+    for (;;) {
+        if (stream.avail_out == 0) {
+            if (!writePngChunk("IDAT", m_deflate->output))
+                return false;
+            stream.next_out = reinterpret_cast<Bytef*>(m_deflate->output.data());
+            stream.avail_out = uInt(PNG_CHUNK_BYTES);
+        }
+        if (!finish && stream.avail_in == 0)
+            return true;
+
+        const int result = deflate(&stream, finish ? Z_FINISH : Z_NO_FLUSH);
+        if (result == Z_STREAM_END) {
+            const int used = PNG_CHUNK_BYTES - int(stream.avail_out);
+            return used == 0
+                   || writePngChunk("IDAT", QByteArray::fromRawData(m_deflate->output.constData(), used));
+        }
+        if (result != Z_OK && result != Z_BUF_ERROR)
+            return fail(translate("PNG 压缩失败。"));
+    }
+}
+
+bool StreamingImageWriter::writePngChunk(const char *type, const QByteArray &data)
+{
+    uchar length[4];
+    qToBigEndian<quint32>(quint32(data.size()), length);
+    uLong crc = crc32(0L, reinterpret_cast<const Bytef*>(type), 4);
+    if (!data.isEmpty())
+        crc = crc32(crc, reinterpret_cast<const Bytef*>(data.constData()), uInt(data.size()));
+    uchar checksum[4];
+    qToBigEndian<quint32>(quint32(crc), checksum);
+
+    if (m_file.write(reinterpret_cast<const char*>(length), 4) != 4
+        || m_file.write(type, 4) != 4
+        || m_file.write(data) != data.size()
+        || m_file.write(reinterpret_cast<const char*>(checksum), 4) != 4)
+        return fail(m_file.errorString());
+    return true;
+}
+
+#else
+
+// 没有 zlib 时 supportsFormat 不接受 PNG，以下函数不会被调用
+bool StreamingImageWriter::beginPng() { return fail(translate("此版本不支持逐行写出 PNG。")); }
+bool StreamingImageWriter::writePngRows(const QImage &, int) { return false; }
+bool StreamingImageWriter::writePngChunk(const char *, const QByteArray &) { return false; }
+bool StreamingImageWriter::drainDeflate(bool) { return false; }
+
+#endif
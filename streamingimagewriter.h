@@ -0,0 +1,60 @@
+#ifndef STREAMINGIMAGEWRITER_H
+#define STREAMINGIMAGEWRITER_H
+
+#include <QByteArray>
+#include <QFile>
+#include <QImage>
+#include <QScopedPointer>
+#include <QSize>
+#include <QString>
+
+// 逐行写出的图像编码器：导出时每渲染完一个条带就编码写盘，不需要整幅输出图像。
+// 支持 BMP（无压缩）；编译时找到 zlib（EZ_PASTER_HAVE_ZLIB）时还支持 PNG。
+// 其他格式仍由 QImageWriter 一次编码整幅图像。
+class StreamingImageWriter
+{
+public:
+    // quality 与 QImageWriter 相同（0-100，-1 为默认），PNG 用它决定压缩级别
+    StreamingImageWriter(const QString &fileName, const QByteArray &format, int quality = -1);
+    ~StreamingImageWriter();
+
+    // 该格式（小写，例如 "png"）可以逐行写出
+    static bool supportsFormat(const QByteArray &format);
+
+    // 创建文件并写入文件头。hasAlpha 为 true 时 PNG 保留透明通道；BMP 不保存透明通道，
+    // 只写 24 位颜色
+    bool begin(const QSize &size, bool hasAlpha);
+    // writeRows 期望的像素格式，begin 之后有效
+    QImage::Format rowFormat() const;
+    // 自上而下依次写入 image 的前 rows 行，image 的宽度与格式须与 begin/rowFormat 一致
+    bool writeRows(const QImage &image, int rows);
+    // 所有行写完后结束文件；失败时删除不完整的文件
+    bool finish();
+    // 放弃写入并删除不完整的文件
+    void abort();
+
+    QString errorString() const { return m_errorString; }
+
+private:
+    struct Deflate;
+
+    bool beginBmp();
+    bool beginPng();
+    bool writePngRows(const QImage &image, int rows);
+    bool writePngChunk(const char *type, const QByteArray &data);
+    // 把压缩输出写成 IDAT 块；finish 为 true 时结束压缩流
+    bool drainDeflate(bool finish);
+    bool fail(const QString &errorString);
+
+    QFile m_file;
+    QByteArray m_format;
+    int m_quality;
+    QSize m_size;
+    bool m_hasAlpha;
+    int m_rowsWritten;
+    QString m_errorString;
+    QScopedPointer<Deflate> m_deflate;
+    QByteArray m_previousRow; // PNG Paeth 滤波需要上一行的原始像素
+};
+
+#endif // STREAMINGIMAGEWRITER_H
@@ -0,0 +1,343 @@
+#include "tiledpixmapitem.h"
+#include "imagesource.h"
+
+#include <QCoreApplication>
+#include <QMetaObject>
+#include <QPainter>
+#include <QStyleOptionGraphicsItem>
+#include <QPaintDevice>
+#include <QThreadPool>
+#include <QtMath>
+
+// 任一边超过该像素数时改用分块项
+const int TILE_THRESHOLD = 4096;
+// 概览图的长边像素数，缩小到这个尺寸以下时不再逐块绘制
+const int OVERVIEW_SIZE = 2048;
+// 不支持局部解码的来源在请求的图块周围额外切出的图块圈数
+const int TILE_RING = 1;
+// 缩小解码图块的最粗层级（1/2^MAX_TILE_LEVEL），更小时已经改画概览图
+const int MAX_TILE_LEVEL = 4;
+
+TiledPixmapItem::TiledPixmapItem(const QSharedPointer<ImageSource> &source, QGraphicsItem *parent)
+    : ResizablePixmapItem(QPixmap(), parent),
+      m_source(source),
+      m_loader(QSharedPointer<Loader>::create()),
+      m_overviewLoading(false),
+      m_overviewLastUsed(0)
+{
+    m_loader->item = this;
+    // 需要精确的 exposedRect 才能只绘制暴露的图块
+    setFlag(QGraphicsItem::ItemUsesExtendedStyleOption);
+}
+
+TiledPixmapItem::~TiledPixmapItem()
+{
+    // 仍在解码的结果回到 GUI 线程时不再访问本项
+    m_loader->item = nullptr;
+}
+
+bool TiledPixmapItem::shouldTile(const QSize &size)
+{
+    return size.width() > TILE_THRESHOLD || size.height() > TILE_THRESHOLD;
+}
+
+QRectF TiledPixmapItem::contentRect() const
+{
+    return QRectF(offset(), QSizeF(m_source->size()));
+}
+
+QPainterPath TiledPixmapItem::shape() const
+{
+    QPainterPath path;
+    path.addRect(contentRect());
+    return path;
+}
+
+QImage TiledPixmapItem::toImage() const
+{
+    return m_source->read();
+}
+
+QSharedPointer<ImageSource> TiledPixmapItem::imageSource() const
+{
+    return m_source;
+}
+
+qint64 TiledPixmapItem::park()
+{
+    return evictIdleTiles(-1);
+}
+
+qint64 TiledPixmapItem::memoryBytes() const
+{
+    qint64 bytes = pixmapBytes(m_overview);
+    // 内存来源的图像一直常驻，计入占用，但不能通过释放图块回收
+    if (!m_source->isFileBacked())
+        bytes += m_source->image().sizeInBytes();
+    for (const Tile &tile : m_tiles) {
+        bytes += pixmapBytes(tile.pixmap);
+    }
+    return bytes;
+}
+
+bool TiledPixmapItem::isOpaque() const
+{
+    return !m_source->hasAlphaChannel() && effectiveOpacity() >= 1.0;
+}
+
+qint64 TiledPixmapItem::releaseCaches()
+{
+    return evictIdleTiles(-1);
+}
+
+QRect TiledPixmapItem::tileRect(int level, int column, int row) const
+{
+    const int span = TileSize << level;
+    return QRect(column * span, row * span, span, span)
+        .intersected(QRect(QPoint(0, 0), m_source->size()));
+}
+
+void TiledPixmapItem::requestTiles(int level, const QVector<QPoint> &missing)
+{
+    QVector<QPoint> tiles;
+    for (const QPoint &tile : missing) {
+        if (!m_loadingTiles.contains(tileKey(level, tile.x(), tile.y())))
+            tiles.append(tile);
+    }
+    if (tiles.isEmpty())
+        return;
+
+    // 解码器不支持裁剪（例如 PNG）时读取任何区域都要解码整个文件：同一次解码中顺带切出
+    // 周围一圈图块，平移时不必马上再解码；其余部分不保留，整幅解码由 ImageSource 的缓存负责
+    if (!m_source->supportsPartialRead()) {
+        const QSize size = m_source->size();
+        const int span = TileSize << level;
+        const int columns = (size.width() + span - 1) / span;
+        const int rows = (size.height() + span - 1) / span;
+        QSet<quint64> requested;
+        for (const QPoint &tile : std::as_const(tiles)) {
+            requested.insert(tileKey(level, tile.x(), tile.y()));
+        }
+        const QVector<QPoint> visible = tiles;
+        for (const QPoint &tile : visible) {
+            for (int row = qMax(0, tile.y() - TILE_RING); row <= qMin(rows - 1, tile.y() + TILE_RING); ++row) {
+                for (int column = qMax(0, tile.x() - TILE_RING); column <= qMin(columns - 1, tile.x() + TILE_RING); ++column) {
+                    const quint64 key = tileKey(level, column, row);
+                    if (!requested.contains(key) && !m_tiles.contains(key) && !m_loadingTiles.contains(key)) {
+                        requested.insert(key);
+                        tiles.append(QPoint(column, row));
+                    }
+                }
+            }
+        }
+    }
+
+    QRect region;
+    QVector<QRect> rects;
+    rects.reserve(tiles.size());
+    for (const QPoint &tile : tiles) {
+        m_loadingTiles.insert(tileKey(level, tile.x(), tile.y()));
+        rects.append(tileRect(level, tile.x(), tile.y()));
+        region |= rects.last();
+    }
+
+    const QSharedPointer<ImageSource> source = m_source;
+    const QSharedPointer<Loader> loader = m_loader;
+    QThreadPool::globalInstance()->start([source, loader, level, tiles, rects, region]() {
+        // 图块边界都是 2^level 的整数倍，只有图像右边和下边的图块需要向上取整
+        const int step = 1 << level;
+        const auto scaled = [step](int length) { return (length + step - 1) / step; };
+        const QSize scaledSize = level > 0 ? QSize(scaled(region.width()), scaled(region.height())) : QSize();
+        const QImage image = source->read(region, scaledSize);
+        QVector<QImage> images;
+        images.reserve(rects.size());
+        for (const QRect &rect : rects) {
+            const QRect slice((rect.x() - region.x()) / step, (rect.y() - region.y()) / step,
+                              scaled(rect.width()), scaled(rect.height()));
+            // 在工作线程中完成格式转换，GUI 线程上的 fromImage 就不必再转换
+            images.append(image.isNull() ? QImage() : ImageSource::toNativeFormat(image.copy(slice)));
+        }
+        QMetaObject::invokeMethod(QCoreApplication::instance(), [loader, level, tiles, images]() {
+            if (loader->item)
+                loader->item->onTilesLoaded(level, tiles, images);
+        }, Qt::QueuedConnection);
+    });
+}
+
+void TiledPixmapItem::onTilesLoaded(int level, const QVector<QPoint> &tiles, const QVector<QImage> &images)
+{
+    const qint64 now = monotonicMs();
+    QRectF dirty;
+    for (int i = 0; i < tiles.size(); ++i) {
+        const quint64 key = tileKey(level, tiles.at(i).x(), tiles.at(i).y());
+        m_loadingTiles.remove(key);
+        // 解码失败（例如源文件已被删除）时保持缺失，下次绘制时重试
+        if (images.at(i).isNull())
+            continue;
+        Tile entry;
+        entry.pixmap = QPixmap::fromImage(images.at(i));
+        entry.lastUsed = now;
+        m_tiles.insert(key, entry);
+        dirty |= QRectF(tileRect(level, tiles.at(i).x(), tiles.at(i).y()));
+    }
+    if (!dirty.isEmpty())
+        update(dirty.translated(contentRect().topLeft()));
+}
+
+void TiledPixmapItem::requestOverview()
+{
+    if (!m_overview.isNull() || m_overviewLoading)
+        return;
+    m_overviewLoading = true;
+
+    const QSharedPointer<ImageSource> source = m_source;
+    const QSharedPointer<Loader> loader = m_loader;
+    const QSize scaledSize = m_source->size().scaled(OVERVIEW_SIZE, OVERVIEW_SIZE, Qt::KeepAspectRatio);
+    QThreadPool::globalInstance()->start([source, loader, scaledSize]() {
+        QImage image = source->read(QRect(), scaledSize);
+        if (!image.isNull())
+            image = ImageSource::toNativeFormat(image);
+        QMetaObject::invokeMethod(QCoreApplication::instance(), [loader, image]() {
+            if (loader->item)
+                loader->item->onOverviewLoaded(image);
+        }, Qt::QueuedConnection);
+    });
+}
+
+void TiledPixmapItem::onOverviewLoaded(const QImage &image)
+{
+    m_overviewLoading = false;
+    if (image.isNull())
+        return;
+    m_overview = QPixmap::fromImage(image);
+    m_overviewLastUsed = monotonicMs();
+    update();
+}
+
+void TiledPixmapItem::preload()
+{
+    requestOverview();
+}
+
+void TiledPixmapItem::paintPlaceholder(QPainter *painter, const QRectF &rect) const
+{
+    painter->fillRect(rect, QColor(235, 235, 235));
+}
+
+void TiledPixmapItem::paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget)
+{
+    Q_UNUSED(widget);
+
+    const QRectF bounds = contentRect();
+    QRectF exposed = option->exposedRect.intersected(bounds);
+
+    const qreal deviceScale = QStyleOptionGraphicsItem::levelOfDetailFromTransform(painter->worldTransform())
+                              * painter->device()->devicePixelRatioF();
+    const QSize size = m_source->size();
+
+    if (exposed.isEmpty())
+        return;
+
+    // 被上方不透明项遮住的部分不解码也不绘制
+    painter->save();
+    QRectF visibleRect;
+    if (!clipOccludedRegion(painter, exposed, &visibleRect)) {
+        painter->restore();
+        return;
+    }
+    exposed = exposed.intersected(visibleRect);
+    markPainted();
+
+    if (qMax(size.width(), size.height()) * deviceScale <= OVERVIEW_SIZE) {
+        // 缩得足够小时整幅绘制概览图，避免加载全部图块；概览图解码完成前先画占位
+        m_overviewLastUsed = monotonicMs();
+        if (m_overview.isNull()) {
+            requestOverview();
+            paintPlaceholder(painter, exposed);
+        } else {
+            painter->drawPixmap(bounds, m_overview, QRectF(m_overview.rect()));
+        }
+    } else if (!m_source->isFileBacked()) {
+        // 内存来源的图像已经常驻，直接绘制暴露的部分，不复制图块
+        painter->drawImage(exposed, m_source->image(), exposed.translated(-bounds.topLeft()));
+    } else {
+        // 选择分辨率不低于设备像素的最粗层级：每升一级图块覆盖的源区域边长加倍
+        int level = 0;
+        while (level < MAX_TILE_LEVEL && deviceScale * (2 << level) <= 1.0)
+            ++level;
+        const int span = TileSize << level;
+
+        const QRectF local = exposed.translated(-bounds.topLeft());
+        const int columns = (size.width() + span - 1) / span;
+        const int rows = (size.height() + span - 1) / span;
+        const int firstColumn = qBound(0, qFloor(local.left() / span), columns - 1);
+        const int lastColumn = qBound(0, qCeil(local.right() / span) - 1, columns - 1);
+        const int firstRow = qBound(0, qFloor(local.top() / span), rows - 1);
+        const int lastRow = qBound(0, qCeil(local.bottom() / span) - 1, rows - 1);
+
+        QVector<QPoint> missing;
+        for (int row = firstRow; row <= lastRow; ++row) {
+            for (int column = firstColumn; column <= lastColumn; ++column) {
+                if (!m_tiles.contains(tileKey(level, column, row)))
+                    missing.append(QPoint(column, row));
+            }
+        }
+        if (!missing.isEmpty())
+            requestTiles(level, missing);
+
+        const QSizeF overviewScale(m_overview.width() / qreal(size.width()),
+                                   m_overview.height() / qreal(size.height()));
+        const qint64 now = monotonicMs();
+        for (int row = firstRow; row <= lastRow; ++row) {
+            for (int column = firstColumn; column <= lastColumn; ++column) {
+                const QRectF rect(tileRect(level, column, row));
+                const QRectF target = rect.translated(bounds.topLeft());
+                auto it = m_tiles.find(tileKey(level, column, row));
+                if (it == m_tiles.end()) {
+                    // 图块还在解码（或解码失败）：有概览图时用它顶替，否则画占位
+                    if (m_overview.isNull()) {
+                        paintPlaceholder(painter, target);
+                    } else {
+                        const QRectF source(rect.x() * overviewScale.width(), rect.y() * overviewScale.height(),
+                                            rect.width() * overviewScale.width(), rect.height() * overviewScale.height());
+                        painter->drawPixmap(target, m_overview, source);
+                    }
+                    continue;
+                }
+                it->lastUsed = now;
+                painter->drawPixmap(target, it->pixmap, QRectF(it->pixmap.rect()));
+            }
+        }
+    }
+    painter->restore();
+}
+
+qint64 TiledPixmapItem::evictIdleTiles(qint64 maxIdleMs, const QRectF &keepRect)
+{
+    const qint64 now = monotonicMs();
+    const QRectF keep = keepRect.translated(-contentRect().topLeft());
+    qint64 freed = 0;
+    for (auto it = m_tiles.begin(); it != m_tiles.end();) {
+        const int column = int(it.key() & 0xffff);
+        const int row = int((it.key() >> 16) & 0xffff);
+        const int level = int(it.key() >> 32);
+        // 视口附近的图块即使一段时间没有重绘也保留
+        if (keep.intersects(QRectF(tileRect(level, column, row)))) {
+            it->lastUsed = now;
+            ++it;
+        } else if (now - it->lastUsed > maxIdleMs) {
+            freed += pixmapBytes(it->pixmap);
+            it = m_tiles.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    if (keep.intersects(QRectF(QPointF(0, 0), QSizeF(m_source->size()))))
+        m_overviewLastUsed = now;
+    if (!m_overview.isNull() && now - m_overviewLastUsed > maxIdleMs) {
+        freed += pixmapBytes(m_overview);
+        m_overview = QPixmap();
+    }
+    return freed;
+}
@@ -0,0 +1,84 @@
+#ifndef TILEDPIXMAPITEM_H
+#define TILEDPIXMAPITEM_H
+
+#include "resizablepixmapitem.h"
+
+#include <QHash>
+#include <QSet>
+#include <QVector>
+#include <QRect>
+#include <QSharedPointer>
+
+class ImageSource;
+
+// 超大图片的分块版本：图像被切成 TileSize 见方的图块，只绘制与
+// exposedRect 相交的图块，长时间未绘制的图块可以从内存中释放。
+// 缩小显示时按 1/2^level 缩放解码图块（每块仍为 TileSize 见方，覆盖更大的源区域），
+// 设备像素比例达到 1 以后才解码全分辨率图块。
+// 图块和概览图在全局线程池中解码，绘制时缺失的部分先画占位，解码完成后再重绘。
+// 内存来源的图像本身已经常驻，直接从中绘制，不再复制出图块。
+class TiledPixmapItem : public ResizablePixmapItem
+{
+public:
+    static const int TileSize = 512;
+
+    explicit TiledPixmapItem(const QSharedPointer<ImageSource> &source, QGraphicsItem *parent = nullptr);
+    ~TiledPixmapItem() override;
+
+    // 提前在线程池中解码概览图，项第一次绘制时就不必只显示占位
+    void preload();
+
+    // 任一边超过该尺寸的图片使用分块项
+    static bool shouldTile(const QSize &size);
+
+    void paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget = nullptr) override;
+    QPainterPath shape() const override;
+    QRectF contentRect() const override;
+    QImage toImage() const override;
+    QSharedPointer<ImageSource> imageSource() const override;
+    // 分块项的像素随时可以从来源重新解码，休眠时直接释放全部图块
+    qint64 park() override;
+    void unpark() override {}
+    qint64 memoryBytes() const override;
+    qint64 releaseCaches() override;
+    bool isOpaque() const override;
+
+    // 释放超过 maxIdleMs 未绘制的图块（以及概览图），返回释放的字节数；
+    // 与 keepRect（项坐标）相交的图块视为仍在使用
+    qint64 evictIdleTiles(qint64 maxIdleMs, const QRectF &keepRect = QRectF());
+    int residentTileCount() const { return m_tiles.size(); }
+
+private:
+    struct Tile {
+        QPixmap pixmap;
+        qint64 lastUsed = 0;
+    };
+
+    // 工作线程的结果经由它回到 GUI 线程；项析构时 item 置空，迟到的结果直接丢弃
+    struct Loader {
+        TiledPixmapItem *item = nullptr;
+    };
+
+    static quint64 tileKey(int level, int column, int row)
+    {
+        return (quint64(level) << 32) | (quint64(row) << 16) | quint64(column);
+    }
+    // level 层级图块覆盖的源像素区域
+    QRect tileRect(int level, int column, int row) const;
+    // 在线程池中一次解码覆盖 level 层级所有缺失图块的区域，再切分成图块
+    void requestTiles(int level, const QVector<QPoint> &missing);
+    void requestOverview();
+    void onTilesLoaded(int level, const QVector<QPoint> &tiles, const QVector<QImage> &images);
+    void onOverviewLoaded(const QImage &image);
+    void paintPlaceholder(QPainter *painter, const QRectF &rect) const;
+
+    QSharedPointer<ImageSource> m_source;
+    QSharedPointer<Loader> m_loader;
+    QHash<quint64, Tile> m_tiles;
+    QSet<quint64> m_loadingTiles;
+    QPixmap m_overview;
+    bool m_overviewLoading;
+    qint64 m_overviewLastUsed;
+};
+
+#endif // TILEDPIXMAPITEM_H
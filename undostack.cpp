@@ -0,0 +1,151 @@
+#include "undostack.h"
+
+UndoStack::UndoStack(QObject *parent)
+    : QObject(parent),
+      m_index(0),
+      m_memoryLimit(0)
+{
+}
+
+UndoStack::~UndoStack()
+{
+    qDeleteAll(m_commands);
+}
+
+void UndoStack::push(UndoCommand *command)
+{
+    command->redo();
+
+    // 新操作之后不能再重做被撤销的命令
+    while (m_commands.size() > m_index) {
+        delete m_commands.takeLast();
+    }
+
+    UndoCommand *top = m_index > 0 ? m_commands.at(m_index - 1) : nullptr;
+    if (top && command->id() != -1 && top->id() == command->id() && top->mergeWith(command)) {
+        delete command;
+    } else {
+        m_commands.append(command);
+        ++m_index;
+    }
+
+    enforceMemoryLimit(m_commands.at(m_index - 1));
+    emit changed();
+}
+
+void UndoStack::undo()
+{
+    if (!canUndo())
+        return;
+    m_commands.at(--m_index)->undo();
+    enforceMemoryLimit(m_commands.at(m_index));
+    emit changed();
+}
+
+void UndoStack::redo()
+{
+    if (!canRedo())
+        return;
+    m_commands.at(m_index++)->redo();
+    enforceMemoryLimit(m_commands.at(m_index - 1));
+    emit changed();
+}
+
+QString UndoStack::undoText() const
+{
+    return canUndo() ? m_commands.at(m_index - 1)->text() : QString();
+}
+
+QString UndoStack::redoText() const
+{
+    return canRedo() ? m_commands.at(m_index)->text() : QString();
+}
+
+void UndoStack::clear()
+{
+    qDeleteAll(m_commands);
+    m_commands.clear();
+    m_index = 0;
+    emit changed();
+}
+
+void UndoStack::forgetItem(QGraphicsItem *item)
+{
+    for (int i = m_commands.size() - 1; i >= 0; --i) {
+        if (!m_commands.at(i)->forgetItem(item))
+            continue;
+        delete m_commands.takeAt(i);
+        if (i < m_index)
+            --m_index;
+    }
+    emit changed();
+}
+
+void UndoStack::setMemoryLimit(qint64 bytes)
+{
+    m_memoryLimit = qMax<qint64>(0, bytes);
+    enforceMemoryLimit();
+    emit changed();
+}
+
+qint64 UndoStack::memoryBytes() const
+{
+    qint64 bytes = 0;
+    for (const UndoCommand *command : m_commands) {
+        bytes += command->memoryBytes();
+    }
+    return bytes;
+}
+
+void UndoStack::enforceMemoryLimit(const UndoCommand *keep)
+{
+    if (m_memoryLimit <= 0)
+        return;
+
+    qint64 bytes = memoryBytes();
+    while (bytes > m_memoryLimit) {
+        // 已执行一侧：最早的持有内存的命令，丢弃它和更早的 undoEnd 条命令
+        int undoEnd = -1;
+        for (int i = 0; i < m_index; ++i) {
+            if (m_commands.at(i) == keep)
+                break;
+            if (m_commands.at(i)->memoryBytes() > 0) {
+                undoEnd = i + 1;
+                break;
+            }
+        }
+        // 可重做一侧：最远的持有内存的命令，丢弃它和更晚的命令
+        int redoStart = -1;
+        for (int i = m_commands.size() - 1; i >= m_index; --i) {
+            if (m_commands.at(i) == keep)
+                break;
+            if (m_commands.at(i)->memoryBytes() > 0) {
+                redoStart = i;
+                break;
+            }
+        }
+
+        if (undoEnd < 0 && redoStart < 0) {
+            // 剩下的内存都在 keep 中：不悄悄丢弃刚完成的操作，提醒用户
+            if (keep)
+                emit memoryLimitExceeded(keep->text());
+            return;
+        }
+
+        const int redoCount = redoStart < 0 ? -1 : m_commands.size() - redoStart;
+        if (undoEnd > 0 && (redoCount < 0 || undoEnd <= redoCount)) {
+            for (int i = 0; i < undoEnd; ++i) {
+                UndoCommand *command = m_commands.takeFirst();
+                bytes -= command->memoryBytes();
+                delete command;
+            }
+            m_index -= undoEnd;
+        } else {
+            while (m_commands.size() > redoStart) {
+                UndoCommand *command = m_commands.takeLast();
+                bytes -= command->memoryBytes();
+                delete command;
+            }
+        }
+    }
+}
@@ -0,0 +1,86 @@
+#ifndef UNDOSTACK_H
+#define UNDOSTACK_H
+
+#include <QObject>
+#include <QList>
+#include <QString>
+
+class QGraphicsItem;
+
+// 可撤销的编辑操作。命令只记录几何变化，并通过 QPixmap 的隐式共享引用像素，
+// 不复制像素数据
+class UndoCommand
+{
+public:
+    explicit UndoCommand(const QString &text = QString()) : m_text(text) {}
+    virtual ~UndoCommand() = default;
+
+    virtual void undo() = 0;
+    virtual void redo() = 0;
+
+    // 命令独占持有的内存（已移出场景、只被命令引用的项），用于内存上限
+    virtual qint64 memoryBytes() const { return 0; }
+    // id 相同（且不为 -1）的相邻命令尝试用 mergeWith 合并为一条
+    virtual int id() const { return -1; }
+    virtual bool mergeWith(const UndoCommand *other) { Q_UNUSED(other); return false; }
+    // 场景中的项即将被删除（例如图片解码失败）：去掉命令对它的引用。
+    // 返回 true 表示命令已不再引用任何项，应从栈中移除
+    virtual bool forgetItem(QGraphicsItem *item) { Q_UNUSED(item); return false; }
+
+    QString text() const { return m_text; }
+
+private:
+    Q_DISABLE_COPY(UndoCommand)
+
+    QString m_text;
+};
+
+// 撤销栈。与 QUndoStack 类似，但按命令持有的内存而不是条数限制历史长度：
+// 超过上限时只丢弃真正持有内存的命令。丢弃已执行的命令时，比它更早的命令也无法再撤销，
+// 一并丢弃；丢弃可重做的命令时，比它更晚的一并丢弃。两侧中丢弃条数较少的一侧优先
+class UndoStack : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit UndoStack(QObject *parent = nullptr);
+    ~UndoStack() override;
+
+    // 执行命令（调用 redo）并压栈，丢弃所有可重做的命令。栈接管命令的所有权
+    void push(UndoCommand *command);
+
+    bool canUndo() const { return m_index > 0; }
+    bool canRedo() const { return m_index < m_commands.size(); }
+    QString undoText() const;
+    QString redoText() const;
+
+    void clear();
+    int count() const { return m_commands.size(); }
+    // 从所有命令中去掉对 item 的引用，只移除因此变空的命令，其余历史保持不变
+    void forgetItem(QGraphicsItem *item);
+
+    // 所有命令持有的内存上限，0 表示不限制
+    void setMemoryLimit(qint64 bytes);
+    qint64 memoryLimit() const { return m_memoryLimit; }
+    qint64 memoryBytes() const;
+
+public slots:
+    void undo();
+    void redo();
+
+signals:
+    // 可撤销/可重做状态或命令数量变化
+    void changed();
+    // 刚执行、撤销或重做的命令本身就超过了内存上限，暂时保留；再有新操作时它将被丢弃
+    void memoryLimitExceeded(const QString &text);
+
+private:
+    // keep 为刚执行、撤销或重做的命令，不会被丢弃
+    void enforceMemoryLimit(const UndoCommand *keep = nullptr);
+
+    QList<UndoCommand*> m_commands;
+    int m_index;    // 下一条可重做命令的位置，之前的命令都已执行
+    qint64 m_memoryLimit;
+};
+
+#endif // UNDOSTACK_H